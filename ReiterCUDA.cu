@@ -3,10 +3,13 @@
 #include <chrono>
 #include <stdio.h>
 
-__device__ void GetNeighbourCellIds(size_t cellId, size_t* outIdArray, int width)
+// Grid pointers passed to the kernels point at cell (0, 0) of the padded host
+// layout, so ghost cells sit at negative offsets and rows are pitch apart.
+// Cell ids are 64-bit, since windows can hold more than 2^31 cells.
+__device__ void GetNeighbourCellIds(long long cellId, long long* outIdArray, int pitch)
 {
-    size_t j = cellId % width;
-    size_t i = (cellId - j) / width;
+    int j = cellId % pitch;
+    long long i = (cellId - j) / pitch;
 
     int nOff;
     if (j%2 == 0)
@@ -14,69 +17,77 @@ __device__ void GetNeighbourCellIds(size_t cellId, size_t* outIdArray, int width
     else
         nOff = 0;
         
-    outIdArray[0] = width * (i-1) + j;
-    outIdArray[1] = width * (nOff + i) + j - 1;
-    outIdArray[2] = width * (nOff + i+1) + j - 1;
-    outIdArray[3] = width * (nOff + i) + j + 1;
-    outIdArray[4] = width * (nOff + i+1) + j + 1;
-    outIdArray[5] = width * (i+1) + j;
+    outIdArray[0] = pitch * (i-1) + j;
+    outIdArray[1] = pitch * (nOff + i) + j - 1;
+    outIdArray[2] = pitch * (nOff + i+1) + j - 1;
+    outIdArray[3] = pitch * (nOff + i) + j + 1;
+    outIdArray[4] = pitch * (nOff + i+1) + j + 1;
+    outIdArray[5] = pitch * (i+1) + j;
 }
 
-__device__ bool CheckReceptiveCell(float* data, size_t cellId, int width, int height)
+__device__ bool CheckReceptiveCell(float* data, long long i, int j, int pitch)
 {
-    if(data[cellId] >= 1)
+    if(data[pitch * i + j] >= 1)
         return true;
 
-    int j = cellId % width;
-    int i = (cellId - j) / width;
-
     int nOff;
     if (j%2 == 0)
         nOff = -1;
     else
         nOff = 0;
         
-    if(i>0 && data[width * (i-1) + j] >= 1)
+    if(data[pitch * (i-1) + j] >= 1)
         return true;
-    if(j>0 && (nOff + i) > 0 && data[width * (nOff + i) + j - 1] >= 1)
+    if(data[pitch * (nOff + i) + j - 1] >= 1)
         return true;
-    if(j>0 && (nOff + i+1) < height && data[width * (nOff + i+1) + j - 1] >= 1)
+    if(data[pitch * (nOff + i+1) + j - 1] >= 1)
         return true;
-    if(j+1 < width && (nOff + i) > 0 && data[width * (nOff + i) + j + 1] >= 1)
+    if(data[pitch * (nOff + i) + j + 1] >= 1)
         return true;
-    if(j+1 < width && (nOff + i+1) < height && data[width * (nOff + i+1) + j + 1] >= 1)
+    if(data[pitch * (nOff + i+1) + j + 1] >= 1)
         return true;
-    if(i+1 < height && data[width * (i+1) + j] >= 1)
+    if(data[pitch * (i+1) + j] >= 1)
         return true;
 
     return false;
 }
 
-__global__ void simulationKernel(float* curData, float* prevData, int height, int width, float alpha, float beta, float gamma)
+__global__ void receptiveMaskKernel(float* data, unsigned char* mask, int pitch, int rowStart, int colStart, int windowHeight, int windowWidth)
 {
-    int cellId = blockIdx.x * blockDim.x + threadIdx.x;
+    size_t k = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
 
-    if (cellId >= height * width)
+    if (k >= (size_t)windowHeight * windowWidth)
         return;
 
-    size_t idArray[6];
-    
-    int j = cellId % width;
-    int i = (cellId - j) / width;
+    long long i = rowStart + k / windowWidth;
+    int j = colStart + k % windowWidth;
+
+    mask[pitch * i + j] = (CheckReceptiveCell(data, i, j, pitch) ? CELL_RECEPTIVE : 0);
+}
+
+__global__ void simulationKernel(float* curData, float* prevData, unsigned char* mask, int pitch, int rowStart, int colStart, int windowHeight, int windowWidth, float alpha, float beta, float gamma)
+{
+    size_t k = (size_t)blockIdx.x * blockDim.x + threadIdx.x;
 
-    if (i == 0 || j == 0 || height - i == 1 || width - j == 1)
+    if (k >= (size_t)windowHeight * windowWidth)
         return;
 
-    GetNeighbourCellIds(cellId, idArray, width);
+    long long idArray[6];
+    
+    long long i = rowStart + k / windowWidth;
+    int j = colStart + k % windowWidth;
+    long long cellId = pitch * i + j;
+
+    GetNeighbourCellIds(cellId, idArray, pitch);
 
     float sum = 0;
     for (int k = 0; k < 6; k++) {
-        int id = idArray[k];
-        if (!CheckReceptiveCell(prevData, id, width, height))
+        long long id = idArray[k];
+        if (!(mask[id] & CELL_RECEPTIVE))
             sum += prevData[id];
     }
 
-    float cellR = (CheckReceptiveCell(prevData, cellId, width, height) ? 1.0 : 0.0);
+    float cellR = ((mask[cellId] & CELL_RECEPTIVE) ? 1.0 : 0.0);
     float cellU = (cellR == 0.0 ? prevData[cellId] : 0.0);
 
     curData[cellId] = prevData[cellId] + (alpha / 2.0) * ((sum / 6.0) - cellU) + (gamma * cellR);
@@ -88,27 +99,44 @@ double ReiterCUDA::RunSimulation(float alpha, float beta, float gamma)
     // Device data
     float* curDataDevice;
     float* prevDataDevice;
+    unsigned char* maskDevice;
 
     // Allocate host memory
     auto hostGrid = CreateGrid(beta);
 
-    // Allocate device memory
-    cudaMalloc((void**)&curDataDevice, m_Height * m_Width * sizeof(float));
-    cudaMalloc((void**)&prevDataDevice, m_Height * m_Width * sizeof(float));
+    // Allocate device memory with the same padded layout as the host grid
+    size_t size = GridStorageSize();
+    size_t origin = CellIndex(0, 0);
+    cudaMalloc((void**)&curDataDevice, size * sizeof(float));
+    cudaMalloc((void**)&prevDataDevice, size * sizeof(float));
+    cudaMalloc((void**)&maskDevice, size * sizeof(unsigned char));
 
     auto start = std::chrono::high_resolution_clock::now();
 
     // Copy initial data to device
-    cudaMemcpy(curDataDevice, hostGrid.get(), m_Height * m_Width * sizeof(float), cudaMemcpyHostToDevice);
-    cudaMemcpy(prevDataDevice, hostGrid.get(), m_Height * m_Width * sizeof(float), cudaMemcpyHostToDevice);
+    cudaMemcpy(curDataDevice, hostGrid.get(), size * sizeof(float), cudaMemcpyHostToDevice);
+    cudaMemcpy(prevDataDevice, hostGrid.get(), size * sizeof(float), cudaMemcpyHostToDevice);
 
     size_t iter = 0;
+    InitActiveBox(hostGrid.get(), nullptr, beta);
 
     while (!IsStable(hostGrid.get()) && iter <= MAX_ITER)
     {
+        int rowStart, rowEnd, colStart, colEnd;
+        GetActiveWindow(&rowStart, &rowEnd, &colStart, &colEnd);
+
+        // The mask is needed one cell beyond the window for the neighbour sums
+        int maskRowStart = rowStart - 1, maskRowEnd = rowEnd + 1;
+        int maskColStart = colStart - 1, maskColEnd = colEnd + 1;
+
         int blockSize = 256;
-        int gridSize = (m_Height * m_Width + blockSize - 1) / blockSize;
-        simulationKernel<<<gridSize, blockSize>>>(curDataDevice, prevDataDevice, m_Height, m_Width, alpha, beta, gamma);
+        int maskGridSize = ((size_t)(maskRowEnd - maskRowStart) * (maskColEnd - maskColStart) + blockSize - 1) / blockSize;
+        int gridSize = ((size_t)(rowEnd - rowStart) * (colEnd - colStart) + blockSize - 1) / blockSize;
+        if (gridSize > 0)
+        {
+            receptiveMaskKernel<<<maskGridSize, blockSize>>>(prevDataDevice + origin, maskDevice + origin, m_Pitch, maskRowStart, maskColStart, maskRowEnd - maskRowStart, maskColEnd - maskColStart);
+            simulationKernel<<<gridSize, blockSize>>>(curDataDevice + origin, prevDataDevice + origin, maskDevice + origin, m_Pitch, rowStart, colStart, rowEnd - rowStart, colEnd - colStart, alpha, beta, gamma);
+        }
 
         cudaDeviceSynchronize();
 
@@ -116,7 +144,9 @@ double ReiterCUDA::RunSimulation(float alpha, float beta, float gamma)
         curDataDevice = prevDataDevice;
         prevDataDevice = tmp;
 
-        cudaMemcpy(hostGrid.get(), prevDataDevice, m_Height * m_Width * sizeof(float), cudaMemcpyDeviceToHost);
+        // Cells outside the window are still beta on the host copy
+        cudaMemcpy(hostGrid.get() + CellIndex(rowStart, 0), prevDataDevice + CellIndex(rowStart, 0), (size_t)(rowEnd - rowStart) * m_Pitch * sizeof(float), cudaMemcpyDeviceToHost);
+        GrowActiveBox(hostGrid.get(), nullptr);
         if(m_DebugFreq == DebugFreq::EveryIter)
             LogState(hostGrid.get(), iter);
 
@@ -124,7 +154,7 @@ double ReiterCUDA::RunSimulation(float alpha, float beta, float gamma)
     }
 
     // Get data from device
-    cudaMemcpy(hostGrid.get(), curDataDevice, m_Height * m_Width * sizeof(float), cudaMemcpyDeviceToHost);
+    cudaMemcpy(hostGrid.get(), curDataDevice, size * sizeof(float), cudaMemcpyDeviceToHost);
     if(m_DebugFreq == DebugFreq::Last)
         LogState(hostGrid.get(), iter);
 
@@ -134,6 +164,7 @@ double ReiterCUDA::RunSimulation(float alpha, float beta, float gamma)
     // Free device memory
     cudaFree(curDataDevice);
     cudaFree(prevDataDevice);
+    cudaFree(maskDevice);
 
     return (duration.count() * 1e-6);
 }
@@ -0,0 +1,409 @@
+#include "ReiterEnsemble.h"
+
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Cell (i, j) of lane l sits at CellIndex(i, j) * ENSEMBLE_LANES + l, and
+// each byte of the mask holds the receptive flag of every lane of a cell.
+
+static inline unsigned FrozenLanes(const float* cell)
+{
+#if defined(__AVX2__)
+    return _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(cell), _mm256_set1_ps(1.0f), _CMP_GE_OQ));
+#else
+    unsigned lanes = 0;
+    for (int l = 0; l < ENSEMBLE_LANES; l++)
+        lanes |= (cell[l] >= 1 ? 1u << l : 0);
+    return lanes;
+#endif
+}
+
+#if defined(__AVX2__)
+static inline __m256 NonReceptiveLanes(unsigned char lanes)
+{
+    __m256i bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    return _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(lanes), bits), _mm256_setzero_si256()));
+}
+#endif
+
+double ReiterEnsemble::RunSimulation(float alpha, float beta, float gamma)
+{
+    size_t iter;
+    return RunEnsemble({{m_Width, m_Height, alpha, beta, gamma}}, &iter, m_DebugFreq != DebugFreq::None);
+}
+
+double ReiterEnsemble::RunEnsemble(const std::vector<ParamSet>& sets, size_t* iters, bool log)
+{
+    // Lanes without a set are never run. Every lane stops on its own the
+    // step the per-lane IsStable holds and keeps its state from then on, so
+    // iters gets the step count each set would reach alone.
+    auto curData = CreateLanes(sets);
+    auto prevData = CreateLanes(sets);
+    size_t maskSize = (GridStorageSize() + GRID_ALIGNMENT - 1) / GRID_ALIGNMENT * GRID_ALIGNMENT;
+    auto mask = std::shared_ptr<unsigned char>((unsigned char*)aligned_alloc(GRID_ALIGNMENT, maskSize), free);
+    auto frozen = std::shared_ptr<unsigned char>((unsigned char*)aligned_alloc(GRID_ALIGNMENT, maskSize), free);
+    auto closed = std::shared_ptr<unsigned char>((unsigned char*)aligned_alloc(GRID_ALIGNMENT, maskSize), free);
+    auto entrySteps = std::shared_ptr<int>((int*)aligned_alloc(GRID_ALIGNMENT, GridStorageSize() * ENSEMBLE_LANES * sizeof(int)), free);
+    memset(mask.get(), 0, maskSize);
+    memset(frozen.get(), 0, maskSize);
+    memset(closed.get(), 0, maskSize);
+
+    // Lanes with the monotone growth of InitReceptiveFrontier track their
+    // interior cells in closed form, as ReiterSequential does
+    unsigned monotone = 0;
+    for (size_t l = 0; l < sets.size(); l++)
+        if (sets[l].alpha >= 0 && sets[l].alpha <= 2 && sets[l].beta >= 0 && sets[l].gamma >= 0)
+            monotone |= 1u << l;
+
+    size_t iter = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    unsigned running = (1u << sets.size()) - 1;
+    running &= ~StableLanes(prevData.get());
+    for (size_t l = 0; l < sets.size(); l++)
+        iters[l] = 0;
+
+    // The active box of the base class covers the cells active in any lane
+    UpdateMask(prevData.get(), frozen.get(), mask.get(), 0, m_Height, 0, m_Width);
+    MarkClosedLanes(mask.get(), closed.get(), entrySteps.get(), running & monotone, 0, 0, m_Height, 0, m_Width);
+    m_ActiveBox = {m_Height, -1, m_Width, -1};
+    ExpandActiveLanes(prevData.get(), mask.get(), sets, 0);
+
+    while(running != 0 && iter <= MAX_ITER)
+    {
+        int rowStart, rowEnd, colStart, colEnd;
+        GetActiveWindow(&rowStart, &rowEnd, &colStart, &colEnd);
+        UpdateCells(curData.get(), prevData.get(), mask.get(), closed.get(), running, sets, rowStart, rowEnd, colStart, colEnd);
+
+        curData.swap(prevData);
+        iter++;
+        for (size_t l = 0; l < sets.size(); l++)
+            if (running & (1u << l))
+                iters[l] = iter;
+        running &= ~StableLanes(prevData.get());
+
+        UpdateMask(prevData.get(), frozen.get(), mask.get(), std::max(rowStart - 1, 0), std::min(rowEnd + 1, m_Height), std::max(colStart - 1, 0), std::min(colEnd + 1, m_Width));
+        MarkClosedLanes(mask.get(), closed.get(), entrySteps.get(), running & monotone, iter, std::max(rowStart - 2, 0), std::min(rowEnd + 2, m_Height), std::max(colStart - 2, 0), std::min(colEnd + 2, m_Width));
+        ExpandActiveLanes(prevData.get(), mask.get(), sets, 1);
+    }
+
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    // Lanes share one set of snapshot names, so the caller logs a single set
+    // or sets that stop at different steps
+    for (size_t l = 0; l < sets.size() && log; l++)
+    {
+        MaterializeLane(prevData.get(), closed.get(), entrySteps.get(), l, sets[l].gamma, iters[l]);
+        LogLane(prevData.get(), l, iters[l]);
+    }
+
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(stop - start);
+    return (duration.count() * 1e-6);
+}
+
+std::shared_ptr<float> ReiterEnsemble::CreateLanes(const std::vector<ParamSet>& sets)
+{
+    size_t size = GridStorageSize() * ENSEMBLE_LANES;
+    auto data = std::shared_ptr<float>((float*)aligned_alloc(GRID_ALIGNMENT, size * sizeof(float)), free);
+    memset(data.get(), 0, size * sizeof(float));
+
+    for (int i = 0; i < m_Height; i++)
+        for (int j = 0; j < m_Width; j++)
+            for (size_t l = 0; l < sets.size(); l++)
+                data.get()[CellIndex(i, j) * ENSEMBLE_LANES + l] = InitialCell(i, j, sets[l].beta);
+
+    return data;
+}
+
+void ReiterEnsemble::UpdateMask(float* data, unsigned char* frozen, unsigned char* mask, int rowStart, int rowEnd, int colStart, int colEnd)
+{
+    // CheckReceptiveCell for every lane of the cells, from the lanes at or
+    // above 1 of each cell and its neighbours. The margin of frozen reaches
+    // into the ghost cells, which stay 0.
+    long evenOffsets[6] = {-m_Pitch, -m_Pitch - 1, -1, -m_Pitch + 1, 1, m_Pitch};
+    long oddOffsets[6] = {-m_Pitch, -1, m_Pitch - 1, 1, m_Pitch + 1, m_Pitch};
+
+    for (int i = rowStart - 1; i < rowEnd + 1; i++)
+    {
+        size_t rowId = CellIndex(i, 0);
+        for (int j = colStart - 1; j < colEnd + 1; j++)
+            frozen[rowId + j] = FrozenLanes(data + (rowId + j) * ENSEMBLE_LANES);
+    }
+
+    for (int i = rowStart; i < rowEnd; i++)
+    {
+        size_t rowId = CellIndex(i, 0);
+        for (int j = colStart; j < colEnd; j++)
+        {
+            size_t cellId = rowId + j;
+            long* offsets = (j % 2 == 0 ? evenOffsets : oddOffsets);
+
+            unsigned char lanes = frozen[cellId];
+            for (int k = 0; k < 6; k++)
+                lanes |= frozen[cellId + offsets[k]];
+            mask[cellId] = lanes;
+        }
+    }
+}
+
+void ReiterEnsemble::MarkClosedLanes(unsigned char* mask, unsigned char* closed, int* entrySteps, unsigned lanes, size_t step, int rowStart, int rowEnd, int colStart, int colEnd)
+{
+    // MarkInteriorCell for every lane. A lane is closed at the first step it
+    // is receptive here and at every neighbour, away from the border cells
+    // IsStable reads, and keeps its value and that step from then on.
+    long evenOffsets[6] = {-m_Pitch, -m_Pitch - 1, -1, -m_Pitch + 1, 1, m_Pitch};
+    long oddOffsets[6] = {-m_Pitch, -1, m_Pitch - 1, 1, m_Pitch + 1, m_Pitch};
+
+    rowStart = std::max(rowStart, 2);
+    rowEnd = std::min(rowEnd, m_Height - 2);
+    colStart = std::max(colStart, 2);
+    colEnd = std::min(colEnd, m_Width - 2);
+
+    for (int i = rowStart; i < rowEnd; i++)
+    {
+        size_t rowId = CellIndex(i, 0);
+        for (int j = colStart; j < colEnd; j++)
+        {
+            size_t cellId = rowId + j;
+            unsigned char fresh = mask[cellId] & lanes & ~closed[cellId];
+            if (fresh == 0)
+                continue;
+
+            long* offsets = (j % 2 == 0 ? evenOffsets : oddOffsets);
+            for (int k = 0; k < 6; k++)
+                fresh &= mask[cellId + offsets[k]];
+
+            closed[cellId] |= fresh;
+            for (int l = 0; l < ENSEMBLE_LANES; l++)
+                if (fresh & (1u << l))
+                    entrySteps[cellId * ENSEMBLE_LANES + l] = step;
+        }
+    }
+}
+
+void ReiterEnsemble::MaterializeLane(float* data, unsigned char* closed, int* entrySteps, int lane, float gamma, size_t step)
+{
+    // MaterializeInterior for one lane, with the same float arithmetic
+    for (int i = 0; i < m_Height; i++)
+    {
+        size_t rowId = CellIndex(i, 0);
+        for (int j = 0; j < m_Width; j++)
+        {
+            size_t id = (rowId + j) * ENSEMBLE_LANES + lane;
+            if (closed[rowId + j] & (1u << lane))
+                data[id] = data[id] + gamma * (step - (size_t)entrySteps[id]);
+        }
+    }
+}
+
+void ReiterEnsemble::UpdateCells(float* curData, float* prevData, unsigned char* mask, unsigned char* closed, unsigned running, const std::vector<ParamSet>& sets, int rowStart, int rowEnd, int colStart, int colEnd)
+{
+    // The update of ReiterSequential, with the neighbours summed in the same
+    // order and the same mix of float and double arithmetic, on all lanes
+    // at once. Stopped and closed lanes copy their old value.
+    long evenOffsets[6] = {-m_Pitch, -m_Pitch - 1, -1, -m_Pitch + 1, 1, m_Pitch};
+    long oddOffsets[6] = {-m_Pitch, -1, m_Pitch - 1, 1, m_Pitch + 1, m_Pitch};
+
+    double halfAlpha[ENSEMBLE_LANES] = {0};
+    float gamma[ENSEMBLE_LANES] = {0};
+    for (size_t l = 0; l < sets.size(); l++)
+    {
+        halfAlpha[l] = sets[l].alpha / 2.0;
+        gamma[l] = sets[l].gamma;
+    }
+
+#if defined(__AVX2__)
+    __m256d alphaLo = _mm256_loadu_pd(halfAlpha);
+    __m256d alphaHi = _mm256_loadu_pd(halfAlpha + 4);
+    __m256 gammaLanes = _mm256_loadu_ps(gamma);
+    __m256d six = _mm256_set1_pd(6.0);
+#endif
+
+    for (int i = rowStart; i < rowEnd; i++)
+    {
+        size_t rowId = CellIndex(i, 0);
+        for (int j = colStart; j < colEnd; j++)
+        {
+            size_t cellId = rowId + j;
+            long* offsets = (j % 2 == 0 ? evenOffsets : oddOffsets);
+            float* mid = prevData + cellId * ENSEMBLE_LANES;
+            float* out = curData + cellId * ENSEMBLE_LANES;
+
+            // A lane receptive here and at every neighbour only gains gamma,
+            // which is the full update with the diffusion term at 0
+            unsigned char interior = mask[cellId];
+            for (int k = 0; k < 6; k++)
+                interior &= mask[cellId + offsets[k]];
+            unsigned live = running & ~closed[cellId];
+
+#if defined(__AVX2__)
+            __m256 liveLanes = NonReceptiveLanes(~live & 0xFF);
+            if ((interior & live) == live)
+            {
+                __m256 value = _mm256_loadu_ps(mid);
+                __m256d lo = _mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(value)), _mm256_cvtps_pd(_mm256_castps256_ps128(gammaLanes)));
+                __m256d hi = _mm256_add_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(value, 1)), _mm256_cvtps_pd(_mm256_extractf128_ps(gammaLanes, 1)));
+                __m256 result = _mm256_set_m128(_mm256_cvtpd_ps(hi), _mm256_cvtpd_ps(lo));
+                _mm256_storeu_ps(out, _mm256_blendv_ps(value, result, liveLanes));
+                continue;
+            }
+
+            __m256 sum = _mm256_setzero_ps();
+            for (int k = 0; k < 6; k++)
+                sum = _mm256_add_ps(sum, _mm256_and_ps(NonReceptiveLanes(mask[cellId + offsets[k]]), _mm256_loadu_ps(mid + offsets[k] * ENSEMBLE_LANES)));
+
+            __m256 value = _mm256_loadu_ps(mid);
+            __m256 nr = NonReceptiveLanes(mask[cellId]);
+            __m256 cellU = _mm256_and_ps(nr, value);
+            __m256 cellR = _mm256_andnot_ps(nr, _mm256_set1_ps(1.0f));
+            __m256 growth = _mm256_mul_ps(gammaLanes, cellR);
+
+            __m256d lo = _mm256_cvtps_pd(_mm256_castps256_ps128(value));
+            lo = _mm256_add_pd(lo, _mm256_mul_pd(alphaLo, _mm256_sub_pd(_mm256_div_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(sum)), six), _mm256_cvtps_pd(_mm256_castps256_ps128(cellU)))));
+            lo = _mm256_add_pd(lo, _mm256_cvtps_pd(_mm256_castps256_ps128(growth)));
+            __m256d hi = _mm256_cvtps_pd(_mm256_extractf128_ps(value, 1));
+            hi = _mm256_add_pd(hi, _mm256_mul_pd(alphaHi, _mm256_sub_pd(_mm256_div_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(sum, 1)), six), _mm256_cvtps_pd(_mm256_extractf128_ps(cellU, 1)))));
+            hi = _mm256_add_pd(hi, _mm256_cvtps_pd(_mm256_extractf128_ps(growth, 1)));
+
+            __m256 result = _mm256_set_m128(_mm256_cvtpd_ps(hi), _mm256_cvtpd_ps(lo));
+            _mm256_storeu_ps(out, _mm256_blendv_ps(value, result, liveLanes));
+#else
+            for (int l = 0; l < ENSEMBLE_LANES; l++)
+            {
+                if (!(live & (1u << l)))
+                {
+                    out[l] = mid[l];
+                    continue;
+                }
+                if (interior & (1u << l))
+                {
+                    out[l] = mid[l] + (double)gamma[l];
+                    continue;
+                }
+
+                float sum = 0;
+                for (int k = 0; k < 6; k++)
+                    if (!(mask[cellId + offsets[k]] & (1u << l)))
+                        sum += mid[offsets[k] * ENSEMBLE_LANES + l];
+
+                float cellR = ((mask[cellId] & (1u << l)) ? 1.0 : 0.0);
+                float cellU = (cellR == 0.0 ? mid[l] : 0.0);
+
+                out[l] = mid[l] + halfAlpha[l] * ((sum / 6.0) - cellU) + (gamma[l] * cellR);
+            }
+#endif
+        }
+    }
+}
+
+bool ReiterEnsemble::IsActiveLanes(float* data, unsigned char* mask, size_t cellId, const std::vector<ParamSet>& sets)
+{
+    if (mask[cellId] != 0)
+        return true;
+
+    for (size_t l = 0; l < sets.size(); l++)
+        if (data[cellId * ENSEMBLE_LANES + l] != sets[l].beta)
+            return true;
+
+    return false;
+}
+
+void ReiterEnsemble::ExpandActiveLanes(float* data, unsigned char* mask, const std::vector<ParamSet>& sets, int steps)
+{
+    // ExpandActiveBox with a cell active when it is active in any lane. An
+    // empty box takes the whole grid as the band.
+    ActiveBox box = m_ActiveBox;
+    bool empty = box.rowMin > box.rowMax;
+
+    int rowStart = (empty ? 0 : std::max(box.rowMin - steps, 0));
+    int rowEnd = (empty ? m_Height - 1 : std::min(box.rowMax + steps, m_Height - 1));
+    int colStart = (empty ? 0 : std::max(box.colMin - steps, 0));
+    int colEnd = (empty ? m_Width - 1 : std::min(box.colMax + steps, m_Width - 1));
+
+    for (int i = rowStart; i <= rowEnd; i++)
+    {
+        size_t rowId = CellIndex(i, 0);
+        for (int j = colStart; j <= colEnd; j++)
+        {
+            if (i >= box.rowMin && i <= box.rowMax && j >= box.colMin && j <= box.colMax)
+                continue;
+            if (!IsActiveLanes(data, mask, rowId + j, sets))
+                continue;
+
+            m_ActiveBox.rowMin = std::min(m_ActiveBox.rowMin, i);
+            m_ActiveBox.rowMax = std::max(m_ActiveBox.rowMax, i);
+            m_ActiveBox.colMin = std::min(m_ActiveBox.colMin, j);
+            m_ActiveBox.colMax = std::max(m_ActiveBox.colMax, j);
+        }
+    }
+}
+
+unsigned ReiterEnsemble::StableLanes(float* data)
+{
+    // IsStable for every lane
+    unsigned lanes = 0;
+    for (int i = 1; i < m_Height - 1; i++)
+        lanes |= FrozenLanes(data + CellIndex(i, 1) * ENSEMBLE_LANES) | FrozenLanes(data + CellIndex(i, m_Width - 2) * ENSEMBLE_LANES);
+
+    for (int j = 1; j < m_Width - 1; j++)
+        lanes |= FrozenLanes(data + CellIndex(1, j) * ENSEMBLE_LANES) | FrozenLanes(data + CellIndex(m_Height - 2, j) * ENSEMBLE_LANES);
+
+    return lanes;
+}
+
+void ReiterEnsemble::LogLane(float* data, int lane, size_t iter)
+{
+    auto grid = CreateGrid(0);
+    for (int i = 0; i < m_Height; i++)
+        for (int j = 0; j < m_Width; j++)
+            grid.get()[CellIndex(i, j)] = data[CellIndex(i, j) * ENSEMBLE_LANES + lane];
+
+    LogState(grid.get(), iter);
+}
+
+int main(int argc, char** argv){
+
+    int width, height;
+    float alpha, beta, gamma;
+
+    // Either a single set on the command line or a file of sets as taken by
+    // ReiterSweep, run ENSEMBLE_LANES sets of the same size at a time
+    std::vector<ReiterSimulation::ParamSet> sets;
+    if (ReiterSimulation::ParseInputParams(argc, argv, &width, &height, &alpha, &beta, &gamma))
+        sets.push_back({width, height, alpha, beta, gamma});
+    else if (argc != 2 || !ReiterSimulation::ReadParamSets(argv[1], &sets))
+    {
+        printf("Correct usage should be: %s <width> <height> <alpha> <beta> <gamma>\n", argv[0]);
+        printf("                      or: %s <file with a line of <width> <height> <alpha> <beta> <gamma> per run>\n", argv[0]);
+        return -1;
+    }
+
+    std::stable_sort(sets.begin(), sets.end(), [](const ReiterSimulation::ParamSet& a, const ReiterSimulation::ParamSet& b){
+        return a.width != b.width ? a.width < b.width : a.height < b.height;
+    });
+
+    bool log = (sets.size() == 1 || ReiterSimulation::GetEnvOption("REITER_SWEEP_LOG", 0));
+    for (size_t first = 0; first < sets.size(); )
+    {
+        size_t last = first + 1;
+        while (last < sets.size() && last - first < ENSEMBLE_LANES && sets[last].width == sets[first].width && sets[last].height == sets[first].height)
+            last++;
+
+        std::vector<ReiterSimulation::ParamSet> batch(sets.begin() + first, sets.begin() + last);
+        size_t iters[ENSEMBLE_LANES];
+        ReiterEnsemble model(batch[0].width, batch[0].height);
+        auto dur = model.RunEnsemble(batch, iters, log);
+
+        for (size_t l = 0; l < batch.size(); l++)
+            printf("{\"type\": \"Ensemble\", \"n\": %d, \"elapsed\": %lf, \"width\": %d, \"height\": %d, \"alpha\": %f, \"beta\": %f, \"gamma\": %f, \"iters\": %zu},\n", (int)batch.size(), dur, batch[l].width, batch[l].height, batch[l].alpha, batch[l].beta, batch[l].gamma, iters[l]);
+
+        first = last;
+    }
+
+    return 0;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "ReiterSim.h"
+
+#define ENSEMBLE_LANES 8
+
+// Runs up to ENSEMBLE_LANES simulations of the same grid size at once. The
+// grids are interleaved cell by cell, so every cell is a vector with one
+// lane per parameter set and the update handles all of them in one pass.
+class ReiterEnsemble : public ReiterSimulation{
+    public:
+        ReiterEnsemble(int width, int height) : ReiterSimulation(width, height) {};
+
+        virtual double RunSimulation(float alpha, float beta, float gamma) override;
+
+        double RunEnsemble(const std::vector<ParamSet>& sets, size_t* iters, bool log);
+
+    private:
+        std::shared_ptr<float> CreateLanes(const std::vector<ParamSet>& sets);
+        void UpdateMask(float* data, unsigned char* frozen, unsigned char* mask, int rowStart, int rowEnd, int colStart, int colEnd);
+        void MarkClosedLanes(unsigned char* mask, unsigned char* closed, int* entrySteps, unsigned lanes, size_t step, int rowStart, int rowEnd, int colStart, int colEnd);
+        void MaterializeLane(float* data, unsigned char* closed, int* entrySteps, int lane, float gamma, size_t step);
+        void UpdateCells(float* curData, float* prevData, unsigned char* mask, unsigned char* closed, unsigned running, const std::vector<ParamSet>& sets, int rowStart, int rowEnd, int colStart, int colEnd);
+        bool IsActiveLanes(float* data, unsigned char* mask, size_t cellId, const std::vector<ParamSet>& sets);
+        void ExpandActiveLanes(float* data, unsigned char* mask, const std::vector<ParamSet>& sets, int steps);
+        unsigned StableLanes(float* data);
+        void LogLane(float* data, int lane, size_t iter);
+};
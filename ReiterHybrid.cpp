@@ -0,0 +1,61 @@
+#include "ReiterHybrid.h"
+
+#include <omp.h>
+
+// One rank per node or socket runs the block loop of ReiterMPI and splits the
+// rows of every update across its threads. All MPI calls stay on the master
+// thread between the parallel loops, so the halos posted before the interior
+// update are in flight while the threads compute.
+
+void ReiterHybrid::UpdateMaskCells(float* block, unsigned char* mask, const Block& cells)
+{
+    if (cells.colFirst >= cells.colLast)
+        return;
+
+    #pragma omp parallel for schedule(static)
+    for (int i = cells.rowFirst; i < cells.rowLast; i++)
+        UpdateMaskRow(block + BlockRow(i), mask + BlockRow(i), m_BlockPitch, BlockCol(cells.colFirst), BlockCol(cells.colLast));
+}
+
+void ReiterHybrid::UpdateCells(float* curBlock, float* prevBlock, unsigned char* mask, const Block& cells, float alpha, float gamma)
+{
+    if (cells.colFirst >= cells.colLast)
+        return;
+
+    #pragma omp parallel for schedule(static)
+    for (int i = cells.rowFirst; i < cells.rowLast; i++)
+        UpdateRowCells(curBlock + BlockRow(i), prevBlock + BlockRow(i), mask + BlockRow(i), m_BlockPitch, BlockCol(cells.colFirst), BlockCol(cells.colLast), alpha, gamma);
+}
+
+int main(int argc, char** argv){
+
+    int width, height;
+    float alpha, beta, gamma;
+
+    if (!ReiterSimulation::ParseInputParams(argc, argv, &width, &height, &alpha, &beta, &gamma))
+    {
+        printf("Correct usage should be: %s <width> <height> <alpha> <beta> <gamma>\n", argv[0]);
+        return -1;
+    }
+
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+
+	int rank, n_proc;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &n_proc);
+
+    ReiterHybrid model(width, height);
+
+    if(rank == 0){
+        auto dur = model.RunSimulation(alpha, beta, gamma);
+        printf("{\"type\": \"Hybrid\", \"n\": %d, \"threads\": %d, \"elapsed\": %lf, \"width\": %d, \"height\": %d, \"alpha\": %f, \"beta\": %f, \"gamma\": %f},\n", n_proc, omp_get_max_threads(), dur, width, height, alpha, beta, gamma);
+    }
+    else{
+        model.Simulation(alpha, beta, gamma);
+    }
+
+    MPI_Finalize();
+
+    return 0;
+}
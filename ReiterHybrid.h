@@ -0,0 +1,12 @@
+#pragma once
+
+#include "ReiterMPI.h"
+
+class ReiterHybrid : public ReiterMPI{
+    public:
+        ReiterHybrid(int width, int height) : ReiterMPI(width, height) {};
+
+    protected:
+        virtual void UpdateMaskCells(float* block, unsigned char* mask, const Block& cells) override;
+        virtual void UpdateCells(float* curBlock, float* prevBlock, unsigned char* mask, const Block& cells, float alpha, float gamma) override;
+};
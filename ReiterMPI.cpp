@@ -1,15 +1,18 @@
 #include "ReiterMPI.h"
 
 #include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <typeinfo>
 #include <mpi.h>
 
-#define min(a,b) (((a)<(b))?(a):(b))
-#define max(a,b) (((a)>(b))?(a):(b))
+#define HALO_STEPS 1
+#define REBALANCE_STEPS 64
 
 double ReiterMPI::RunSimulation(float alpha, float beta, float gamma)
 {
     auto start = std::chrono::high_resolution_clock::now();
-    
+
     Simulation(alpha, beta, gamma);
 
     auto stop = std::chrono::high_resolution_clock::now();
@@ -18,143 +21,752 @@ double ReiterMPI::RunSimulation(float alpha, float beta, float gamma)
     return (duration.count() * 1e-6);
 }
 
-void GetNeighbourCellIdsMPI(size_t global_cell_id, int* outIdArray, int width)
+static int BlockStart(int length, int parts, int k)
 {
-    size_t j = global_cell_id % width;
+    return (int)((long)length * k / parts);
+}
 
-    int nOff;
-    if (j%2 == 0)
-        nOff = -1;
-    else
-        nOff = 0;
-        
-    outIdArray[0] = width * (-1);
-    outIdArray[1] = width * (nOff) - 1;
-    outIdArray[2] = width * (nOff+1) - 1;
-    outIdArray[3] = width * (nOff) + 1;
-    outIdArray[4] = width * (nOff+1) + 1;
-    outIdArray[5] = width * (1);
+static std::vector<int> BalancedCuts(int length, int parts, int first, int last, int minSize)
+{
+    // Splits the active range [first, last) evenly, the cells outside of it
+    // go to the outer parts. Every part keeps at least minSize cells.
+    std::vector<int> cuts(parts + 1);
+    cuts[0] = 0;
+    cuts[parts] = length;
+    for (int k = 1; k < parts; k++)
+        cuts[k] = std::max(first + (int)((long)(last - first) * k / parts), cuts[k - 1] + minSize);
+    for (int k = parts - 1; k > 0; k--)
+        cuts[k] = std::min(cuts[k], cuts[k + 1] - minSize);
+
+    return cuts;
 }
 
-void ReiterMPI::Simulation(float alpha, float beta, float gamma){
+static bool EmptyBlock(const ReiterMPI::Block& block)
+{
+    return block.rowFirst >= block.rowLast || block.colFirst >= block.colLast;
+}
 
-    int rank, n_proc;
-	MPI_Comm_size(MPI_COMM_WORLD, &n_proc);
-	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+static ReiterMPI::Block GrowBlock(const ReiterMPI::Block& block, int cells)
+{
+    return {block.rowFirst - cells, block.rowLast + cells, block.colFirst - cells, block.colLast + cells};
+}
 
-    std::shared_ptr<float> curData;
-    
-    curData = CreateGrid(beta);
-    
-    int N = m_Width * m_Height;
-	int block_size = N / n_proc + 1;
+static ReiterMPI::Block ClipBlock(const ReiterMPI::Block& block, const ReiterMPI::Block& bounds)
+{
+    return {std::max(block.rowFirst, bounds.rowFirst), std::min(block.rowLast, bounds.rowLast),
+        std::max(block.colFirst, bounds.colFirst), std::min(block.colLast, bounds.colLast)};
+}
 
-	int* rcv_buf_sizes = new int[n_proc];
-	int* rcv_buf_displ = new int[n_proc];
+static void SplitBlock(const ReiterMPI::Block& block, const ReiterMPI::Block& inner, ReiterMPI::Block* pieces)
+{
+    // pieces[0] is the part of block inside inner, the other four cover the
+    // rest of it. Pieces may be empty.
+    int rowFirst = std::max(block.rowFirst, inner.rowFirst);
+    int rowLast = std::min(block.rowLast, inner.rowLast);
+
+    pieces[0] = {rowFirst, rowLast, std::max(block.colFirst, inner.colFirst), std::min(block.colLast, inner.colLast)};
+    pieces[1] = {block.rowFirst, std::min(inner.rowFirst, block.rowLast), block.colFirst, block.colLast};
+    pieces[2] = {std::max(inner.rowLast, block.rowFirst), block.rowLast, block.colFirst, block.colLast};
+    pieces[3] = {rowFirst, rowLast, block.colFirst, std::min(inner.colFirst, block.colLast)};
+    pieces[4] = {rowFirst, rowLast, std::max(inner.colLast, block.colFirst), block.colLast};
+}
 
-	int* snd_buf_sizes = new int[n_proc];
-	int* snd_buf_displ = new int[n_proc];
-    
-	int snd_sum = 0;
-    for (int i = 0; i < n_proc; i++)
-	{
-		int diff = min(block_size, N - snd_sum);
-		snd_buf_sizes[i] = diff;
-		snd_buf_displ[i] = snd_sum;
-		snd_sum += diff;
+void ReiterMPI::PartitionBlocks(int rank, int nProc)
+{
+    // Blocks need at least m_Halo cells in each direction so that a halo
+    // comes from a single neighbour; use fewer ranks when the grid is too small.
+    // Ranks outside the topology own nothing.
+    int dims[2];
+    for (int n = nProc; n > 0; n--)
+    {
+        dims[0] = dims[1] = 0;
+        MPI_Dims_create(n, 2, dims);
+        if (m_Height / dims[0] >= m_Halo && m_Width / dims[1] >= m_Halo)
+            break;
+    }
 
-        int rcv_buf_start_pad = min((m_Width + 1) * 2, snd_buf_displ[i]);
-        int rcv_buf_stop_pad = min((m_Width + 1) * 2, N - snd_buf_displ[i] - snd_buf_sizes[i]);
+    int periods[2] = {0, 0};
+    MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, 0, &m_CartComm);
+    m_Dims[0] = dims[0];
+    m_Dims[1] = dims[1];
 
-        rcv_buf_sizes[i] = snd_buf_sizes[i] + rcv_buf_start_pad + rcv_buf_stop_pad;
-		rcv_buf_displ[i] = snd_buf_displ[i] - rcv_buf_start_pad;
-	}
+    for (int d = 0; d < 9; d++)
+    {
+        m_Neighbours[d] = MPI_PROC_NULL;
+        m_HaloTypes[d] = MPI_DATATYPE_NULL;
+        m_SharedBlocks[d] = nullptr;
+    }
 
-    int start_cell_id = snd_buf_displ[rank];
-    int rcv_buf_start_pad = snd_buf_displ[rank] - rcv_buf_displ[rank];
+    // All eight neighbours are exchanged in one round so the halos can be
+    // in flight while the interior is updated. The diagonal neighbours of
+    // either column parity reach into the corner blocks.
+    if (m_CartComm != MPI_COMM_NULL)
+    {
+        int coords[2];
+        MPI_Cart_coords(m_CartComm, rank, 2, coords);
+        for (int d = 0; d < 9; d++)
+        {
+            int neighbour[2] = {coords[0] + d / 3 - 1, coords[1] + d % 3 - 1};
+            if (d != 4 && neighbour[0] >= 0 && neighbour[0] < dims[0] && neighbour[1] >= 0 && neighbour[1] < dims[1])
+                MPI_Cart_rank(m_CartComm, neighbour, &m_Neighbours[d]);
+        }
+    }
 
-	int rcv_buf_size = rcv_buf_sizes[rank];
-    int snd_buf_size = snd_buf_sizes[rank];
+    std::vector<int> rowCuts(dims[0] + 1), colCuts(dims[1] + 1);
+    for (int k = 0; k <= dims[0]; k++)
+        rowCuts[k] = BlockStart(m_Height, dims[0], k);
+    for (int k = 0; k <= dims[1]; k++)
+        colCuts[k] = BlockStart(m_Width, dims[1], k);
+    SetBlocks(rowCuts, colCuts);
+}
 
-	auto rcv_buf = std::shared_ptr<float>((float*)malloc(rcv_buf_size * sizeof(float)), free);
-    auto snd_buf = std::shared_ptr<float>((float*)malloc(snd_buf_size * sizeof(float)), free);
+std::vector<ReiterMPI::Block> ReiterMPI::CutBlocks(const std::vector<int>& rowCuts, const std::vector<int>& colCuts)
+{
+    // Without reordering, rank r sits at (r / m_Dims[1], r % m_Dims[1])
+    int nProc;
+    MPI_Comm_size(MPI_COMM_WORLD, &nProc);
 
-    auto idArray = std::shared_ptr<int>((int*)malloc(6 * sizeof(int)), free);
-    auto idArrayS = std::shared_ptr<int>((int*)malloc(6 * sizeof(int)), free);
+    std::vector<Block> blocks(nProc, {m_Height, m_Height, m_Width, m_Width});
+    for (int r = 0; r < m_Dims[0] * m_Dims[1]; r++)
+    {
+        int row = r / m_Dims[1];
+        int col = r % m_Dims[1];
+        blocks[r] = {rowCuts[row], rowCuts[row + 1], colCuts[col], colCuts[col + 1]};
+    }
 
-    size_t iter = 0;
-    bool stable = false;
+    return blocks;
+}
+
+void ReiterMPI::SetBlocks(const std::vector<int>& rowCuts, const std::vector<int>& colCuts)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    m_RowCuts = rowCuts;
+    m_ColCuts = colCuts;
+    m_Blocks = CutBlocks(rowCuts, colCuts);
+    m_Block = m_Blocks[rank];
+    BlockLayout(m_Block, &m_ColOffset, &m_BlockPitch);
+
+    if (m_CartComm == MPI_COMM_NULL)
+        return;
+
+    int rows = m_Block.rowLast - m_Block.rowFirst;
+    int cols = m_Block.colLast - m_Block.colFirst;
+    for (int d = 0; d < 9; d++)
+    {
+        if (d == 4)
+            continue;
+        if (m_HaloTypes[d] != MPI_DATATYPE_NULL)
+            MPI_Type_free(&m_HaloTypes[d]);
 
-    while(iter <= MAX_ITER && !stable){
+        MPI_Type_vector(d / 3 == 1 ? rows : m_Halo, d % 3 == 1 ? cols : m_Halo, m_BlockPitch, MPI_FLOAT, &m_HaloTypes[d]);
+        MPI_Type_commit(&m_HaloTypes[d]);
+    }
+}
 
-	    MPI_Scatterv(curData.get(), rcv_buf_sizes, rcv_buf_displ, MPI_FLOAT, rcv_buf.get(), rcv_buf_size, MPI_FLOAT, 0, MPI_COMM_WORLD);
+void ReiterMPI::BlockLayout(const Block& block, int* colOffset, int* pitch)
+{
+    *colOffset = m_Halo + block.colFirst % 2;
+    int align = GRID_ALIGNMENT / sizeof(float);
+    *pitch = (*colOffset + block.colLast - block.colFirst + m_Halo + align - 1) / align * align;
+}
 
-        for(int i=0; i < snd_buf_size; i++){
+size_t ReiterMPI::BlockRow(int i)
+{
+    return (size_t)(i - m_Block.rowFirst + m_Halo) * m_BlockPitch;
+}
 
-            int global_cell_id = start_cell_id + i;
-            int global_j = global_cell_id % m_Width;
-            int global_i = (global_cell_id - global_j) / m_Width;
+int ReiterMPI::BlockCol(int j)
+{
+    return j - m_Block.colFirst + m_ColOffset;
+}
 
-            if(global_i == 0 || global_j == 0 || m_Height - global_i == 1 || m_Width - global_j == 1){
-                snd_buf.get()[i] = beta;
+ReiterMPI::Block ReiterMPI::HaloCells(int d, bool owned)
+{
+    // Halo cells received from direction d, or the owned cells sent to it
+    int dr = d / 3 - 1;
+    int dc = d % 3 - 1;
+    Block cells = m_Block;
+
+    if (dr < 0)
+        cells = (owned ? Block{m_Block.rowFirst, m_Block.rowFirst + m_Halo, cells.colFirst, cells.colLast} : Block{m_Block.rowFirst - m_Halo, m_Block.rowFirst, cells.colFirst, cells.colLast});
+    else if (dr > 0)
+        cells = (owned ? Block{m_Block.rowLast - m_Halo, m_Block.rowLast, cells.colFirst, cells.colLast} : Block{m_Block.rowLast, m_Block.rowLast + m_Halo, cells.colFirst, cells.colLast});
+
+    if (dc < 0)
+        cells = (owned ? Block{cells.rowFirst, cells.rowLast, m_Block.colFirst, m_Block.colFirst + m_Halo} : Block{cells.rowFirst, cells.rowLast, m_Block.colFirst - m_Halo, m_Block.colFirst});
+    else if (dc > 0)
+        cells = (owned ? Block{cells.rowFirst, cells.rowLast, m_Block.colLast - m_Halo, m_Block.colLast} : Block{cells.rowFirst, cells.rowLast, m_Block.colLast, m_Block.colLast + m_Halo});
+
+    return cells;
+}
+
+void ReiterMPI::PostHalos(float* block, MPI_Request* requests)
+{
+    // Sixteen requests: a receive and a send per direction. The tag is the
+    // direction as seen by the sender. Neighbours in the shared window are
+    // copied by WaitHalos instead.
+    for (int d = 0; d < 9; d++)
+    {
+        if (d == 4)
+            continue;
+
+        int k = (d < 4 ? d : d - 1);
+        if (m_CartComm == MPI_COMM_NULL || m_SharedBlocks[d])
+        {
+            requests[2 * k] = requests[2 * k + 1] = MPI_REQUEST_NULL;
+            continue;
+        }
+
+        Block recv = HaloCells(d, false);
+        Block send = HaloCells(d, true);
+        MPI_Irecv(block + BlockRow(recv.rowFirst) + BlockCol(recv.colFirst), 1, m_HaloTypes[d], m_Neighbours[d], 8 - d, m_CartComm, &requests[2 * k]);
+        MPI_Isend(block + BlockRow(send.rowFirst) + BlockCol(send.colFirst), 1, m_HaloTypes[d], m_Neighbours[d], d, m_CartComm, &requests[2 * k + 1]);
+    }
+}
+
+void ReiterMPI::WaitHalos(float* block, MPI_Request* requests)
+{
+    // Every rank of the node calls this for the same buffer, so once all of
+    // them have passed the barrier the owned cells of that buffer are final
+    // until the next block
+    if (m_Window != MPI_WIN_NULL)
+    {
+        MPI_Win_sync(m_Window);
+        MPI_Barrier(m_NodeComm);
+        MPI_Win_sync(m_Window);
+
+        size_t buffer = (block - m_SharedBase) / m_BlockSize;
+        for (int d = 0; d < 9; d++)
+        {
+            if (!m_SharedBlocks[d])
                 continue;
-            }
 
-            GetNeighbourCellIdsMPI(global_cell_id, idArray.get(), m_Width);
-            float sum = 0;
-            bool receptive = rcv_buf.get()[rcv_buf_start_pad + i] >= 1;
-            for(int k = 0; k < 6; k++){
-                int id = idArray.get()[k] + rcv_buf_start_pad + i;
-                bool receptiveS = false;
-                if(rcv_buf.get()[id] >= 1)
-                    receptiveS = true;
-                else{
-                    GetNeighbourCellIdsMPI(global_cell_id + idArray.get()[k], idArrayS.get(), m_Width);
-                    for (int v = 0; v < 6; v++)
-                    {
-                        if(id + idArrayS.get()[v] >= 0 && id + idArrayS.get()[v] < rcv_buf_size)
-                            if(rcv_buf.get()[id + idArrayS.get()[v]] >= 1)
-                                receptiveS = true;
-                        if(receptiveS)
-                            break;
-                    }
-                }
-                
-                if(!receptiveS)
-                    sum += rcv_buf.get()[id];
-                if(rcv_buf.get()[id] >= 1)
-                    receptive = true;
+            Block neighbour = m_Blocks[m_Neighbours[d]];
+            int colOffset, pitch;
+            BlockLayout(neighbour, &colOffset, &pitch);
+            float* neighbourBlock = m_SharedBlocks[d] + buffer * (neighbour.rowLast - neighbour.rowFirst + 2 * m_Halo) * pitch;
+
+            Block cells = HaloCells(d, false);
+            for (int i = cells.rowFirst; i < cells.rowLast; i++)
+            {
+                float* src = neighbourBlock + (size_t)(i - neighbour.rowFirst + m_Halo) * pitch + (cells.colFirst - neighbour.colFirst + colOffset);
+                memcpy(block + BlockRow(i) + BlockCol(cells.colFirst), src, (cells.colLast - cells.colFirst) * sizeof(float));
             }
+        }
+    }
+
+    MPI_Waitall(16, requests, MPI_STATUSES_IGNORE);
+}
+
+float* ReiterMPI::AllocateSharedBlocks(int count)
+{
+    // One window segment per rank of the node holding all of its buffers
+    if (m_NodeComm == MPI_COMM_NULL)
+        MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &m_NodeComm);
+
+    MPI_Info info;
+    MPI_Info_create(&info);
+    MPI_Info_set(info, "alloc_shared_noncontig", "true");
+    MPI_Win_allocate_shared(count * m_BlockSize * sizeof(float), sizeof(float), info, m_NodeComm, &m_SharedBase, &m_Window);
+    MPI_Info_free(&info);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, m_Window);
+
+    MPI_Group worldGroup, nodeGroup;
+    MPI_Comm_group(MPI_COMM_WORLD, &worldGroup);
+    MPI_Comm_group(m_NodeComm, &nodeGroup);
+
+    for (int d = 0; d < 9; d++)
+    {
+        if (m_Neighbours[d] == MPI_PROC_NULL)
+            continue;
+
+        int nodeRank;
+        MPI_Group_translate_ranks(worldGroup, 1, &m_Neighbours[d], nodeGroup, &nodeRank);
+        if (nodeRank == MPI_UNDEFINED)
+            continue;
+
+        MPI_Aint size;
+        int dispUnit;
+        MPI_Win_shared_query(m_Window, nodeRank, &size, &dispUnit, &m_SharedBlocks[d]);
+    }
 
-            float cellR = (receptive ? 1.0 : 0.0);
-            float cellU = (cellR == 0.0 ? rcv_buf.get()[rcv_buf_start_pad + i] : 0.0);
+    MPI_Group_free(&worldGroup);
+    MPI_Group_free(&nodeGroup);
+
+    return m_SharedBase;
+}
+
+void ReiterMPI::AllocateBlocks(std::shared_ptr<float>* buffers, int count, std::shared_ptr<unsigned char>& mask, bool shared)
+{
+    // Sized for the current block. With REITER_SHARED_HALOS=1 the buffers
+    // live in a node wide window and halos from ranks on the same node are
+    // read from their buffers.
+    for (int b = 0; b < 3; b++)
+        buffers[b].reset();
+    if (m_Window != MPI_WIN_NULL)
+    {
+        MPI_Win_unlock_all(m_Window);
+        MPI_Win_free(&m_Window);
+    }
+
+    m_BlockSize = BlockRow(m_Block.rowLast + m_Halo);
+    float* base = (shared ? AllocateSharedBlocks(count) : nullptr);
+    for (int b = 0; b < count; b++)
+    {
+        if (base)
+            buffers[b] = std::shared_ptr<float>(base + b * m_BlockSize, [](float*){});
+        else
+            buffers[b] = std::shared_ptr<float>((float*)aligned_alloc(GRID_ALIGNMENT, m_BlockSize * sizeof(float)), free);
+        memset(buffers[b].get(), 0, m_BlockSize * sizeof(float));
+    }
+
+    size_t maskSize = (m_BlockSize + GRID_ALIGNMENT - 1) / GRID_ALIGNMENT * GRID_ALIGNMENT;
+    mask = std::shared_ptr<unsigned char>((unsigned char*)aligned_alloc(GRID_ALIGNMENT, maskSize), free);
+    memset(mask.get(), 0, maskSize);
+}
+
+void ReiterMPI::StartBlocks(std::shared_ptr<float>* buffers, int count, unsigned char* mask, MPI_Request* requests)
+{
+    // Halo cells of a block are only recomputed inside the window, so every
+    // copy starts from the exchanged block and agrees outside of it
+    PostHalos(buffers[0].get(), requests);
+    WaitHalos(buffers[0].get(), requests);
+    for (int b = 1; b < count; b++)
+        memcpy(buffers[b].get(), buffers[0].get(), m_BlockSize * sizeof(float));
+
+    UpdateMaskCells(buffers[0].get(), mask, MaskCells(m_HaloSteps + 1));
+}
+
+MPI_Datatype ReiterMPI::CellsType(const Block& cells, int pitch)
+{
+    // One element of this type covers the rows of cells in a buffer with the
+    // given pitch, so transfers never need element counts past INT_MAX
+    MPI_Datatype type;
+    MPI_Type_vector(cells.rowLast - cells.rowFirst, cells.colLast - cells.colFirst, pitch, MPI_FLOAT, &type);
+    MPI_Type_commit(&type);
+    return type;
+}
+
+std::vector<float> ReiterMPI::MigrateCells(float* block, const std::vector<Block>& blocks)
+{
+    // Every rank sends the part of its block that each new block covers and
+    // gets the pieces of its new block back, straight from and into place.
+    // Returns the new block without halos.
+    int rank, nProc;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nProc);
+
+    const Block& target = blocks[rank];
+    int cols = target.colLast - target.colFirst;
+    std::vector<float> cells(EmptyBlock(target) ? 0 : (size_t)(target.rowLast - target.rowFirst) * cols);
+
+    std::vector<MPI_Request> requests;
+    std::vector<MPI_Datatype> types;
+    for (int r = 0; r < nProc; r++)
+    {
+        Block piece = ClipBlock(m_Blocks[r], target);
+        if (EmptyBlock(piece))
+            continue;
+
+        types.push_back(CellsType(piece, cols));
+        requests.emplace_back();
+        MPI_Irecv(cells.data() + (size_t)(piece.rowFirst - target.rowFirst) * cols + (piece.colFirst - target.colFirst),
+            1, types.back(), r, 0, MPI_COMM_WORLD, &requests.back());
+    }
+    for (int r = 0; r < nProc; r++)
+    {
+        Block piece = ClipBlock(m_Block, blocks[r]);
+        if (EmptyBlock(piece))
+            continue;
 
-            snd_buf.get()[i] = rcv_buf.get()[rcv_buf_start_pad + i] +  (alpha / 2.0) * ((sum / 6.0) - cellU) + (gamma * cellR);
+        types.push_back(CellsType(piece, m_BlockPitch));
+        requests.emplace_back();
+        MPI_Isend(block + BlockRow(piece.rowFirst) + BlockCol(piece.colFirst), 1, types.back(), r, 0, MPI_COMM_WORLD, &requests.back());
+    }
+
+    MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+    for (auto& type : types)
+        MPI_Type_free(&type);
+
+    return cells;
+}
+
+bool ReiterMPI::Rebalance(std::shared_ptr<float>* buffers, int count, std::shared_ptr<unsigned char>& mask, bool shared)
+{
+    // Only the active window is computed, so its rows and columns are split
+    // evenly between the rows and columns of the process grid
+    int rowStart, rowEnd, colStart, colEnd;
+    GetActiveWindow(&rowStart, &rowEnd, &colStart, &colEnd);
+    std::vector<int> rowCuts = BalancedCuts(m_Height, m_Dims[0], rowStart, rowEnd, m_Halo);
+    std::vector<int> colCuts = BalancedCuts(m_Width, m_Dims[1], colStart, colEnd, m_Halo);
+    if (rowCuts == m_RowCuts && colCuts == m_ColCuts)
+        return false;
+
+    std::vector<float> cells = MigrateCells(buffers[0].get(), CutBlocks(rowCuts, colCuts));
+    SetBlocks(rowCuts, colCuts);
+    AllocateBlocks(buffers, count, mask, shared);
+
+    int cols = m_Block.colLast - m_Block.colFirst;
+    for (int i = m_Block.rowFirst; i < m_Block.rowLast && cols > 0; i++)
+        memcpy(buffers[0].get() + BlockRow(i) + BlockCol(m_Block.colFirst), cells.data() + (size_t)(i - m_Block.rowFirst) * cols, cols * sizeof(float));
+
+    return true;
+}
+
+void ReiterMPI::UpdateMaskCells(float* block, unsigned char* mask, const Block& cells)
+{
+    for (int i = cells.rowFirst; i < cells.rowLast && cells.colFirst < cells.colLast; i++)
+        UpdateMaskRow(block + BlockRow(i), mask + BlockRow(i), m_BlockPitch, BlockCol(cells.colFirst), BlockCol(cells.colLast));
+}
+
+void ReiterMPI::UpdateCells(float* curBlock, float* prevBlock, unsigned char* mask, const Block& cells, float alpha, float gamma)
+{
+    for (int i = cells.rowFirst; i < cells.rowLast && cells.colFirst < cells.colLast; i++)
+        UpdateRowCells(curBlock + BlockRow(i), prevBlock + BlockRow(i), mask + BlockRow(i), m_BlockPitch, BlockCol(cells.colFirst), BlockCol(cells.colLast), alpha, gamma);
+}
+
+ReiterMPI::Block ReiterMPI::MaskCells(int reach)
+{
+    // The owned cells and the first halo ring, limited to reach cells around
+    // the current box. Reach has to cover the scan ring and one cell around
+    // the next window.
+    Block cells = ClipBlock(GrowBlock(m_Block, 1), {0, m_Height, 0, m_Width});
+    if (m_ActiveBox.rowMin > m_ActiveBox.rowMax)
+        return cells;
+
+    Block box = {m_ActiveBox.rowMin, m_ActiveBox.rowMax + 1, m_ActiveBox.colMin, m_ActiveBox.colMax + 1};
+    return ClipBlock(cells, GrowBlock(box, reach));
+}
+
+int ReiterMPI::ReduceStatus(float* block, unsigned char* mask, int steps, int edgeStep, bool fullScan)
+{
+    // The first step that reached the edge followed by the active box, all
+    // reduced with MIN. The scan covers the last of the steps.
+    if (ScanActiveCells(block, mask, steps, fullScan))
+        edgeStep = std::min(edgeStep, steps);
+
+    int status[5] = {edgeStep, m_ActiveBox.rowMin, -m_ActiveBox.rowMax, m_ActiveBox.colMin, -m_ActiveBox.colMax};
+    MPI_Allreduce(MPI_IN_PLACE, status, 5, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    m_ActiveBox = {status[1], -status[2], status[3], -status[4]};
+
+    return status[0];
+}
+
+bool ReiterMPI::EdgeCells(float* block, const Block& cells)
+{
+    // Same cells as EdgeReached, restricted to cells
+    bool edgeReached = false;
+    for (int i = cells.rowFirst; i < cells.rowLast; i++)
+    {
+        float* row = block + BlockRow(i);
+        if (i == 1 || i == m_Height - 2)
+        {
+            for (int j = std::max(cells.colFirst, 1); j < std::min(cells.colLast, m_Width - 1); j++)
+                edgeReached = edgeReached || row[BlockCol(j)] >= 1;
+        }
+        else if (i > 1 && i < m_Height - 2)
+        {
+            if (cells.colFirst <= 1 && cells.colLast > 1)
+                edgeReached = edgeReached || row[BlockCol(1)] >= 1;
+            if (cells.colFirst <= m_Width - 2 && cells.colLast > m_Width - 2)
+                edgeReached = edgeReached || row[BlockCol(m_Width - 2)] >= 1;
+        }
+    }
+
+    return edgeReached;
+}
+
+bool ReiterMPI::ScanActiveCells(float* block, unsigned char* mask, int steps, bool fullScan)
+{
+    // Local part of ExpandActiveBox and IsStable. Only the cells of the last
+    // windows can have changed, and they also cover the band around the box.
+    ActiveBox box = m_ActiveBox;
+    int rowStart = (fullScan ? m_Block.rowFirst : std::max(box.rowMin - steps, m_Block.rowFirst));
+    int rowEnd = (fullScan ? m_Block.rowLast : std::min(box.rowMax + steps + 1, m_Block.rowLast));
+    int colStart = (fullScan ? m_Block.colFirst : std::max(box.colMin - steps, m_Block.colFirst));
+    int colEnd = (fullScan ? m_Block.colLast : std::min(box.colMax + steps + 1, m_Block.colLast));
+
+    bool edgeReached = EdgeCells(block, {rowStart, rowEnd, colStart, colEnd});
+    for (int i = rowStart; i < rowEnd; i++)
+    {
+        float* row = block + BlockRow(i);
+        unsigned char* maskRow = mask + BlockRow(i);
+
+        bool inside = !fullScan && i >= box.rowMin && i <= box.rowMax;
+        for (int j = colStart; j < colEnd; j++)
+        {
+            if (inside && j == box.colMin)
+                j = box.colMax + 1;
+            if (j >= colEnd || (row[BlockCol(j)] == m_Beta && !(maskRow[BlockCol(j)] & CELL_RECEPTIVE)))
+                continue;
+
+            m_ActiveBox.rowMin = std::min(m_ActiveBox.rowMin, i);
+            m_ActiveBox.rowMax = std::max(m_ActiveBox.rowMax, i);
+            m_ActiveBox.colMin = std::min(m_ActiveBox.colMin, j);
+            m_ActiveBox.colMax = std::max(m_ActiveBox.colMax, j);
+        }
+    }
+
+    return edgeReached;
+}
+
+void ReiterMPI::GatherGrid(float* block, float* grid)
+{
+    // Every block goes to rank 0 as one element of a strided type, placed
+    // directly into the grid there
+    int rank, nProc;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nProc);
+
+    std::vector<MPI_Request> requests;
+    std::vector<MPI_Datatype> types;
+    for (int r = 0; r < nProc && rank == 0; r++)
+    {
+        Block& b = m_Blocks[r];
+        if (EmptyBlock(b))
+            continue;
+
+        types.push_back(CellsType(b, m_Pitch));
+        requests.emplace_back();
+        MPI_Irecv(grid + CellIndex(b.rowFirst, b.colFirst), 1, types.back(), r, 0, MPI_COMM_WORLD, &requests.back());
+    }
+    if (!EmptyBlock(m_Block))
+    {
+        types.push_back(CellsType(m_Block, m_BlockPitch));
+        requests.emplace_back();
+        MPI_Isend(block + BlockRow(m_Block.rowFirst) + BlockCol(m_Block.colFirst), 1, types.back(), 0, 0, MPI_COMM_WORLD, &requests.back());
+    }
+
+    MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+    for (auto& type : types)
+        MPI_Type_free(&type);
+}
+
+void ReiterMPI::WriteSnapshot(float* block, size_t iter)
+{
+    // The layout of SaveStateToRaw, written collectively with every rank at
+    // the offset of its block so the grid is never gathered
+    std::string filename = std::string(typeid(*this).name()) + std::to_string(iter) + std::string(".bin");
+    int header[2] = {m_Width, m_Height};
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    MPI_File file;
+    MPI_File_open(MPI_COMM_WORLD, filename.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file);
+    MPI_File_set_size(file, sizeof(header) + (MPI_Offset)m_Width * m_Height * sizeof(float));
+    if (rank == 0)
+        MPI_File_write_at(file, 0, header, 2, MPI_INT, MPI_STATUS_IGNORE);
+
+    // Ranks without a block take part with an empty write
+    MPI_Datatype fileType = MPI_FLOAT, cellType = MPI_FLOAT;
+    int count = 0;
+    if (!EmptyBlock(m_Block))
+    {
+        int sizes[2] = {m_Height, m_Width};
+        int subsizes[2] = {m_Block.rowLast - m_Block.rowFirst, m_Block.colLast - m_Block.colFirst};
+        int starts[2] = {m_Block.rowFirst, m_Block.colFirst};
+        MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_FLOAT, &fileType);
+        MPI_Type_commit(&fileType);
+        MPI_Type_vector(subsizes[0], subsizes[1], m_BlockPitch, MPI_FLOAT, &cellType);
+        MPI_Type_commit(&cellType);
+        count = 1;
+    }
+
+    MPI_File_set_view(file, sizeof(header), MPI_FLOAT, fileType, "native", MPI_INFO_NULL);
+    MPI_File_write_at_all(file, 0, block + BlockRow(m_Block.rowFirst) + BlockCol(m_Block.colFirst), count, cellType, MPI_STATUS_IGNORE);
+    MPI_File_close(&file);
+
+    if (count > 0)
+    {
+        MPI_Type_free(&fileType);
+        MPI_Type_free(&cellType);
+    }
+}
+
+void ReiterMPI::LogBlocks(float* block, size_t iter)
+{
+    // Raw snapshots are written in parallel, the other formats are gathered
+    // and written by rank 0, the only rank that ever holds the whole grid
+    if (m_DebugMode == DebugType::Raw)
+    {
+        WriteSnapshot(block, iter);
+        return;
+    }
+
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    auto grid = (rank == 0 ? CreateGrid(m_Beta) : nullptr);
+    GatherGrid(block, grid.get());
+    if (rank == 0)
+        LogState(grid.get(), iter);
+}
+
+int ReiterMPI::AdvanceBlock(float* prevBlock, float** work, unsigned char* mask, const Block& window, int steps, bool maskReady, float alpha, float gamma, MPI_Request* requests)
+{
+    // Step t reads the halo 2 * (steps - t) deep and leaves valid cells
+    // 2 * (steps - 1 - t) into it, so only the last step needs fresh halos.
+    // The last step updates the cells within m_Halo of the block edge first
+    // and posts them to the neighbours before the rest of the block.
+    Block grid = {0, m_Height, 0, m_Width};
+    Block maskWindow = ClipBlock(GrowBlock(window, 1), grid);
+    Block updateInner = GrowBlock(m_Block, -m_Halo);
+    Block pieces[5];
+    int edgeStep = steps + 1;
+
+    for (int t = 0; t < steps; t++)
+    {
+        float* src = (t == 0 ? prevBlock : work[(t - 1) % 2]);
+        float* dst = work[t % 2];
+        int reach = 2 * (steps - 1 - t);
+
+        // Within one cell of the block the mask of the first step can be
+        // left from the end of the previous block
+        Block maskCells = ClipBlock(ClipBlock(GrowBlock(m_Block, reach + 1), grid), maskWindow);
+        if (t > 0 || !maskReady)
+        {
+            UpdateMaskCells(src, mask, maskCells);
+        }
+        else
+        {
+            SplitBlock(maskCells, GrowBlock(m_Block, 1), pieces);
+            for (int p = 1; p < 5; p++)
+                UpdateMaskCells(src, mask, pieces[p]);
         }
 
-        MPI_Gatherv(snd_buf.get(), snd_buf_size, MPI_FLOAT, curData.get(), snd_buf_sizes, snd_buf_displ, MPI_FLOAT, 0, MPI_COMM_WORLD);
+        if (reach > 0)
+        {
+            Block cells = ClipBlock(GrowBlock(m_Block, reach), window);
+            UpdateCells(dst, src, mask, cells, alpha, gamma);
+            if (edgeStep > steps && EdgeCells(dst, ClipBlock(m_Block, window)))
+                edgeStep = t + 1;
+            continue;
+        }
+
+        SplitBlock(ClipBlock(m_Block, window), updateInner, pieces);
+        for (int p = 1; p < 5; p++)
+            UpdateCells(dst, src, mask, pieces[p], alpha, gamma);
+
+        PostHalos(dst, requests);
+        UpdateCells(dst, src, mask, pieces[0], alpha, gamma);
+    }
+
+    return edgeStep;
+}
+
+void ReiterMPI::Simulation(float alpha, float beta, float gamma){
+
+    int rank, n_proc;
+	MPI_Comm_size(MPI_COMM_WORLD, &n_proc);
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    // REITER_HALO_STEPS=k trades halos 2 * k cells deep and recomputes the
+    // overlap with the neighbours, so ranks exchange and reduce once every
+    // k steps. Every iteration has to be logged with k = 1.
+    m_HaloSteps = std::max(GetEnvOption("REITER_HALO_STEPS", HALO_STEPS), 1);
+    if (m_DebugFreq == DebugFreq::EveryIter)
+        m_HaloSteps = 1;
+    m_Halo = 2 * m_HaloSteps;
+
+    PartitionBlocks(rank, n_proc);
+
+    // Each rank keeps its block and only trades halos, apart from the
+    // periodic rebalancing. Deeper halos advance through two work blocks
+    // so the block start is kept for a replay.
+    bool shared = GetEnvOption("REITER_SHARED_HALOS", 0);
+    int rebalanceSteps = GetEnvOption("REITER_REBALANCE_STEPS", REBALANCE_STEPS);
+    int bufferCount = (m_HaloSteps > 1 ? 3 : 2);
+    std::shared_ptr<float> buffers[3];
+    std::shared_ptr<unsigned char> mask;
+    AllocateBlocks(buffers, bufferCount, mask, shared);
+
+    // Ranks only ever allocate their own block and halos
+    for (int i = m_Block.rowFirst; i < m_Block.rowLast; i++)
+        for (int j = m_Block.colFirst; j < m_Block.colLast; j++)
+            buffers[0].get()[BlockRow(i) + BlockCol(j)] = InitialCell(i, j, beta);
+
+    m_Beta = beta;
+    m_ActiveBox = {m_Height, -1, m_Width, -1};
+
+    MPI_Request requests[16];
+    StartBlocks(buffers, bufferCount, mask.get(), requests);
+    bool stable = ReduceStatus(buffers[0].get(), mask.get(), 0, 1, true) == 0;
+
+    Block pieces[5];
+    size_t iter = 0;
+    size_t nextRebalance = rebalanceSteps;
+    while(!stable && iter <= MAX_ITER){
+
+        // The active window moves between blocks as it grows, so the work
+        // is split again every REITER_REBALANCE_STEPS iterations
+        if (rebalanceSteps > 0 && iter >= nextRebalance)
+        {
+            nextRebalance = iter + rebalanceSteps;
+            if (Rebalance(buffers, bufferCount, mask, shared))
+                StartBlocks(buffers, bufferCount, mask.get(), requests);
+        }
 
-        if(rank == 0){
-            if(m_DebugFreq == DebugFreq::EveryIter)
-                LogState(curData.get(), iter);
-            
-            stable = IsStable(curData.get());
+        int steps = (int)std::min((size_t)m_HaloSteps, MAX_ITER + 1 - iter);
+        int rowStart, rowEnd, colStart, colEnd;
+        GetActiveWindow(&rowStart, &rowEnd, &colStart, &colEnd, steps);
+        Block window = {rowStart, rowEnd, colStart, colEnd};
+
+        float* work[2] = {buffers[1].get(), buffers[2].get()};
+        int edgeStep = AdvanceBlock(buffers[0].get(), work, mask.get(), window, steps, true, alpha, gamma, requests);
+        float* result = work[(steps - 1) % 2];
+
+        // The next mask is started while the halos are in flight
+        SplitBlock(MaskCells(steps + m_HaloSteps + 1), GrowBlock(m_Block, -1), pieces);
+        UpdateMaskCells(result, mask.get(), pieces[0]);
+
+        WaitHalos(result, requests);
+        for (int p = 1; p < 5; p++)
+            UpdateMaskCells(result, mask.get(), pieces[p]);
+
+        edgeStep = ReduceStatus(result, mask.get(), steps, edgeStep, false);
+        stable = edgeStep <= steps;
+
+        // The edge was reached inside the block, so redo it from the block
+        // start up to that step to stop where the per-step loop would
+        if (edgeStep < steps)
+        {
+            steps = edgeStep;
+            AdvanceBlock(buffers[0].get(), work, mask.get(), window, steps, false, alpha, gamma, requests);
+            WaitHalos(work[(steps - 1) % 2], requests);
         }
 
-        MPI_Bcast(&stable, 1, MPI_C_BOOL, 0, MPI_COMM_WORLD);
+        buffers[0].swap(buffers[1 + (steps - 1) % 2]);
+
+        if(m_DebugFreq == DebugFreq::EveryIter)
+            LogBlocks(buffers[0].get(), iter);
 
-        iter++;
+        iter += steps;
     }
 
-    if(rank == 0 && m_DebugFreq == DebugFreq::Last)
-        LogState(curData.get(), iter);
+    if(m_DebugFreq == DebugFreq::Last)
+        LogBlocks(buffers[0].get(), iter);
 
-    delete[] rcv_buf_sizes;
-    delete[] rcv_buf_displ;
-    delete[] snd_buf_sizes;
-    delete[] snd_buf_displ;
+    for (int b = 0; b < 3; b++)
+        buffers[b].reset();
+    if (m_Window != MPI_WIN_NULL)
+    {
+        MPI_Win_unlock_all(m_Window);
+        MPI_Win_free(&m_Window);
+    }
+    if (m_NodeComm != MPI_COMM_NULL)
+        MPI_Comm_free(&m_NodeComm);
+
+    if (m_CartComm != MPI_COMM_NULL)
+    {
+        for (int d = 0; d < 9; d++)
+            if (m_HaloTypes[d] != MPI_DATATYPE_NULL)
+                MPI_Type_free(&m_HaloTypes[d]);
+        MPI_Comm_free(&m_CartComm);
+    }
 }
 
+#ifndef REITER_NO_MAIN
 int main(int argc, char** argv){
 
     int width, height;
@@ -185,4 +797,5 @@ int main(int argc, char** argv){
     MPI_Finalize();
 
     return 0;
-}
\ No newline at end of file
+}
+#endif
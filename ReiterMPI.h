@@ -2,11 +2,75 @@
 
 #include "ReiterSim.h"
 
+#include <mpi.h>
+
 class ReiterMPI : public ReiterSimulation{
     public:
-        ReiterMPI(int width, int height) : ReiterSimulation(width, height) {};
+        ReiterMPI(int width, int height) : ReiterSimulation(width, height) { m_DebugMode = DebugType::Raw; };
 
         virtual double RunSimulation(float alpha, float beta, float gamma) override;
-    
+
         void Simulation(float alpha, float beta, float gamma);
-};
\ No newline at end of file
+
+        struct Block {
+            int rowFirst, rowLast;
+            int colFirst, colLast;
+        };
+
+    protected:
+        size_t BlockRow(int i);
+        int BlockCol(int j);
+        virtual void UpdateMaskCells(float* block, unsigned char* mask, const Block& cells);
+        virtual void UpdateCells(float* curBlock, float* prevBlock, unsigned char* mask, const Block& cells, float alpha, float gamma);
+
+        // The owned cells plus a halo two cells deep per step between
+        // exchanges on every side. Local columns are shifted by m_ColOffset,
+        // which keeps the column parity of the global grid so the hex
+        // neighbour pattern is unchanged.
+        Block m_Block = {0, 0, 0, 0};
+        std::vector<Block> m_Blocks;
+        int m_ColOffset = 0;
+        int m_BlockPitch = 0;
+        int m_HaloSteps = 1;
+        int m_Halo = 2;
+
+    private:
+        void PartitionBlocks(int rank, int nProc);
+        std::vector<Block> CutBlocks(const std::vector<int>& rowCuts, const std::vector<int>& colCuts);
+        void SetBlocks(const std::vector<int>& rowCuts, const std::vector<int>& colCuts);
+        void BlockLayout(const Block& block, int* colOffset, int* pitch);
+        Block HaloCells(int d, bool owned);
+        void PostHalos(float* block, MPI_Request* requests);
+        void WaitHalos(float* block, MPI_Request* requests);
+        float* AllocateSharedBlocks(int count);
+        void AllocateBlocks(std::shared_ptr<float>* buffers, int count, std::shared_ptr<unsigned char>& mask, bool shared);
+        void StartBlocks(std::shared_ptr<float>* buffers, int count, unsigned char* mask, MPI_Request* requests);
+        MPI_Datatype CellsType(const Block& cells, int pitch);
+        std::vector<float> MigrateCells(float* block, const std::vector<Block>& blocks);
+        bool Rebalance(std::shared_ptr<float>* buffers, int count, std::shared_ptr<unsigned char>& mask, bool shared);
+        Block MaskCells(int reach);
+        bool EdgeCells(float* block, const Block& cells);
+        bool ScanActiveCells(float* block, unsigned char* mask, int steps, bool fullScan);
+        int ReduceStatus(float* block, unsigned char* mask, int steps, int edgeStep, bool fullScan);
+        int AdvanceBlock(float* prevBlock, float** work, unsigned char* mask, const Block& window, int steps, bool maskReady, float alpha, float gamma, MPI_Request* requests);
+        void GatherGrid(float* block, float* grid);
+        void WriteSnapshot(float* block, size_t iter);
+        void LogBlocks(float* block, size_t iter);
+
+        // Blocks are the products of the row and column cuts of the process
+        // grid
+        int m_Dims[2] = {1, 1};
+        std::vector<int> m_RowCuts, m_ColCuts;
+
+        // Indexed by (dr + 1) * 3 + (dc + 1); entry 4 is the block itself
+        MPI_Comm m_CartComm = MPI_COMM_NULL;
+        int m_Neighbours[9];
+        MPI_Datatype m_HaloTypes[9];
+
+        // Buffers of the neighbours on the same node, null for the others
+        MPI_Comm m_NodeComm = MPI_COMM_NULL;
+        MPI_Win m_Window = MPI_WIN_NULL;
+        float* m_SharedBase = nullptr;
+        float* m_SharedBlocks[9];
+        size_t m_BlockSize = 0;
+};
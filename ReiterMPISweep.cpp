@@ -0,0 +1,226 @@
+#include "ReiterSweep.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <set>
+#include <omp.h>
+#include <mpi.h>
+
+#define TAG_JOB 1
+#define TAG_RESULT 2
+#define WORKER_QUEUE 2
+
+// Task farm over a parameter sweep. Rank 0 hands out points to the workers,
+// most expensive first, and writes each result as it comes back. Between
+// polls for results it runs the cheapest points left itself. Every rank
+// runs its points on the OpenMP backend with all of its threads, so one
+// rank per node is the intended layout.
+
+static double ExpectedCost(const ReiterSimulation::ParamSet& point)
+{
+    // Cells times the steps a crystal growing one cell per step needs to
+    // reach the nearest edge
+    int steps = std::min(std::min(point.width, point.height) / 2, MAX_ITER + 1);
+    return (double)point.width * point.height * steps;
+}
+
+static std::string PointKey(int width, int height, float alpha, float beta, float gamma)
+{
+    // Round-trip precision, so points closer than the printed digits of %f
+    // still get keys of their own
+    char key[128];
+    snprintf(key, sizeof(key), "%d %d %.9g %.9g %.9g", width, height, alpha, beta, gamma);
+    return key;
+}
+
+static std::set<std::string> ReadCheckpoint(const char* filename)
+{
+    // Points with a complete result line. A line cut short by a killed run
+    // does not parse, so its point runs again.
+    std::set<std::string> done;
+    FILE* file = fopen(filename, "r");
+    if (file == nullptr)
+        return done;
+
+    char line[512];
+    while (fgets(line, sizeof(line), file) != nullptr)
+    {
+        int width, height;
+        float alpha, beta, gamma;
+        const char* fields = strstr(line, "\"width\"");
+        if (fields != nullptr && strchr(fields, '}') != nullptr &&
+            sscanf(fields, "\"width\": %d, \"height\": %d, \"alpha\": %f, \"beta\": %f, \"gamma\": %f", &width, &height, &alpha, &beta, &gamma) == 5)
+            done.insert(PointKey(width, height, alpha, beta, gamma));
+    }
+
+    fclose(file);
+    return done;
+}
+
+static void WriteResult(FILE* file, int rank, int threads, double elapsed, const ReiterSimulation::ParamSet& point)
+{
+    fprintf(file, "{\"type\": \"MPISweep\", \"rank\": %d, \"n\": %d, \"elapsed\": %lf, \"width\": %d, \"height\": %d, \"alpha\": %.9g, \"beta\": %.9g, \"gamma\": %.9g}\n", rank, threads, elapsed, point.width, point.height, point.alpha, point.beta, point.gamma);
+    fflush(file);
+}
+
+static void RunMaster(const std::vector<ReiterSimulation::ParamSet>& points, const char* checkpointName, int nProc)
+{
+    // Results go to stdout and are appended to the checkpoint, and points
+    // already in the checkpoint are skipped, so a rerun with the same
+    // arguments resumes the sweep
+    std::set<std::string> done;
+    FILE* checkpoint = nullptr;
+    if (checkpointName != nullptr)
+    {
+        done = ReadCheckpoint(checkpointName);
+        checkpoint = fopen(checkpointName, "a+");
+
+        // New results start on a line of their own after a cut line
+        if (checkpoint != nullptr && fseek(checkpoint, -1, SEEK_END) == 0 && fgetc(checkpoint) != '\n')
+            fputc('\n', checkpoint);
+    }
+
+    std::vector<int> pending;
+    for (size_t k = 0; k < points.size(); k++)
+    {
+        auto& point = points[k];
+        if (!done.count(PointKey(point.width, point.height, point.alpha, point.beta, point.gamma)))
+            pending.push_back(k);
+    }
+    std::stable_sort(pending.begin(), pending.end(), [&](int a, int b){
+        return ExpectedCost(points[a]) > ExpectedCost(points[b]);
+    });
+
+    auto record = [&](int rank, int threads, double elapsed, int job){
+        WriteResult(stdout, rank, threads, elapsed, points[job]);
+        if (checkpoint != nullptr)
+            WriteResult(checkpoint, rank, threads, elapsed, points[job]);
+    };
+
+    // Workers are kept WORKER_QUEUE points deep, so the next point is
+    // already waiting for them while rank 0 is busy with one of its own
+    std::deque<int> queue(pending.begin(), pending.end());
+    std::vector<int> outstanding(nProc, 0);
+    std::vector<bool> stopped(nProc, false);
+    int active = 0;
+
+    // A worker is stopped once it has nothing left to run
+    auto dispatch = [&](int w){
+        if (stopped[w])
+            return;
+
+        int job = -1;
+        if (!queue.empty())
+        {
+            job = queue.front();
+            queue.pop_front();
+        }
+        if (job < 0 && outstanding[w] > 0)
+            return;
+
+        MPI_Send(&job, 1, MPI_INT, w, TAG_JOB, MPI_COMM_WORLD);
+        outstanding[w] += (job >= 0);
+        active += (job >= 0);
+        stopped[w] = (job < 0);
+    };
+
+    auto collect = [&](bool wait){
+        // Index of the point, elapsed time and worker threads
+        int flag = 1;
+        MPI_Status status;
+        if (!wait)
+            MPI_Iprobe(MPI_ANY_SOURCE, TAG_RESULT, MPI_COMM_WORLD, &flag, &status);
+        if (!flag)
+            return false;
+
+        double result[3];
+        MPI_Recv(result, 3, MPI_DOUBLE, MPI_ANY_SOURCE, TAG_RESULT, MPI_COMM_WORLD, &status);
+        record(status.MPI_SOURCE, (int)result[2], result[1], (int)result[0]);
+
+        outstanding[status.MPI_SOURCE]--;
+        active--;
+        dispatch(status.MPI_SOURCE);
+        return true;
+    };
+
+    for (int k = 0; k < WORKER_QUEUE; k++)
+        for (int w = 1; w < nProc; w++)
+            dispatch(w);
+
+    ReiterSweep model(0, 0);
+    while (!queue.empty() || active > 0)
+    {
+        while (collect(false));
+
+        if (!queue.empty())
+        {
+            int job = queue.back();
+            queue.pop_back();
+            record(0, omp_get_max_threads(), model.RunPoint(points[job], false), job);
+        }
+        else if (active > 0)
+        {
+            collect(true);
+        }
+    }
+
+    if (checkpoint != nullptr)
+        fclose(checkpoint);
+}
+
+static void RunWorker(const std::vector<ReiterSimulation::ParamSet>& points)
+{
+    // One model for all points of this rank, so same-size points reuse its
+    // grids
+    ReiterSweep model(0, 0);
+    while (true)
+    {
+        int job;
+        MPI_Recv(&job, 1, MPI_INT, 0, TAG_JOB, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        if (job < 0)
+            break;
+
+        double result[3] = {(double)job, model.RunPoint(points[job], false), (double)omp_get_max_threads()};
+        MPI_Send(result, 3, MPI_DOUBLE, 0, TAG_RESULT, MPI_COMM_WORLD);
+    }
+}
+
+int main(int argc, char** argv){
+
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+
+	int rank, n_proc;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &n_proc);
+
+    // Rank 0 reads the sets and passes them on, so only it needs the file
+    std::vector<ReiterSimulation::ParamSet> points;
+    int count = -1;
+    if (rank == 0 && (argc == 2 || argc == 3) && ReiterSimulation::ReadParamSets(argv[1], &points))
+        count = points.size();
+    MPI_Bcast(&count, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+    if (count < 0)
+    {
+        if (rank == 0)
+            printf("Correct usage should be: %s <file with a line of <width> <height> <alpha> <beta> <gamma> per run> [<checkpoint file>]\n", argv[0]);
+        MPI_Finalize();
+        return -1;
+    }
+
+    points.resize(count);
+    MPI_Bcast(points.data(), count * sizeof(ReiterSimulation::ParamSet), MPI_BYTE, 0, MPI_COMM_WORLD);
+
+    if(rank == 0){
+        RunMaster(points, argc == 3 ? argv[2] : nullptr, n_proc);
+    }
+    else{
+        RunWorker(points);
+    }
+
+    MPI_Finalize();
+
+    return 0;
+}
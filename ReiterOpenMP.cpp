@@ -1,49 +1,153 @@
 #include "ReiterOpenMP.h"
 
 #include <chrono>
+#include <algorithm>
+#include <climits>
+#include <cstring>
 #include <omp.h>
 
+#define TILE_STEPS 8
+#define TILE_ROWS 64
+#define DATAFLOW_TILE_ROWS 16
+#define DATAFLOW_TILE_COLS 64
+#define DATAFLOW_BUFFERS 3
+
 double ReiterOpenMP::RunSimulation(float alpha, float beta, float gamma)
 {
+    // REITER_DATAFLOW=1 drops the step-wide barriers for tiles that each
+    // wait only on their neighbours
+    if (GetEnvOption("REITER_DATAFLOW", 0) && m_DebugFreq != DebugFreq::EveryIter)
+        return RunDataflow(alpha, beta, gamma);
+
+    // REITER_TILE_STEPS=1 keeps the per-step loop with the incremental
+    // frontier; deeper tiles need every step in cache so they are used
+    // unless each iteration has to be logged.
+    int tileSteps = GetEnvOption("REITER_TILE_STEPS", TILE_STEPS);
+    if (tileSteps > 1 && m_DebugFreq != DebugFreq::EveryIter)
+        return RunTiled(alpha, beta, gamma, tileSteps);
+
     auto curData = CreateGrid(beta);
     auto prevData = CreateGrid(beta);
+    auto mask = CreateMask();
 
-    auto numThreads = omp_get_max_threads();
-    size_t idArray[numThreads][6];
     size_t iter = 0;
 
     auto start = std::chrono::high_resolution_clock::now();
-    while(!IsStable(prevData.get()) && iter <= MAX_ITER)
+    InitReceptiveFrontier(prevData.get(), mask.get(), alpha, beta, gamma);
+    InitActiveBox(prevData.get(), mask.get(), beta);
+
+    // One parallel region for the whole run. The edge check is reduced over
+    // the rows as they are updated and the serial bookkeeping runs in a
+    // single block between the barriers. Only the single block writes the
+    // loop state, so every thread leaves the loop on the same iteration.
+    bool stable = IsStable(prevData.get());
+    bool edgeReached = false;
+    int window[4];
+    GetActiveWindow(&window[0], &window[1], &window[2], &window[3]);
+
+    #pragma omp parallel
     {
-        #pragma omp parallel for
-        for (int cellId = 0; cellId < m_Height * m_Width; cellId++)
+        while(!stable && iter <= MAX_ITER)
         {
-            auto threadId = omp_get_thread_num();
-            int j = cellId % m_Width;
-            int i = (cellId - j) / m_Width;
-
-            if(i == 0 || j == 0 || m_Height - i == 1 || m_Width - j == 1)
-                continue;
-            
-            GetNeighbourCellIds(cellId, idArray[threadId]);
-            float sum = 0;
-            for (int k = 0; k < 6; k++){
-                int id = idArray[threadId][k];
-                if (!CheckReceptiveCell(prevData.get(), id))
-                    sum += prevData.get()[id];
+            #pragma omp for schedule(static) reduction(||:edgeReached)
+            for (int i = window[0]; i < window[1]; i++)
+            {
+                UpdateRow(curData.get(), prevData.get(), mask.get(), i, window[2], window[3], alpha, gamma);
+                edgeReached = edgeReached || EdgeReached(curData.get() + CellIndex(i, 0), i);
             }
-            
-            float cellR = (CheckReceptiveCell(prevData.get(), cellId) ? 1.0 : 0.0);
-            float cellU = (cellR == 0.0 ? prevData.get()[cellId] : 0.0);
 
-            curData.get()[cellId] = prevData.get()[cellId] +  (alpha / 2.0) * ((sum / 6.0) - cellU) + (gamma * cellR);
+            #pragma omp single
+            {
+                if(m_DebugFreq == DebugFreq::EveryIter){
+                    MaterializeInterior(curData.get(), iter + 1);
+                    LogState(curData.get(), iter);
+                }
+
+                curData.swap(prevData);
+                AdvanceReceptiveFrontier(prevData.get(), mask.get());
+                GrowActiveBox(prevData.get(), mask.get());
+                GetActiveWindow(&window[0], &window[1], &window[2], &window[3]);
+
+                stable = edgeReached;
+                edgeReached = false;
+                iter++;
+            }
         }
+    }
+    if(m_DebugFreq == DebugFreq::Last){
+        MaterializeInterior(prevData.get(), iter);
+        LogState(prevData.get(), iter);
+    }
 
-        if(m_DebugFreq == DebugFreq::EveryIter)
-            LogState(curData.get(), iter);
+    auto stop = std::chrono::high_resolution_clock::now();
 
-        curData.swap(prevData);
-        iter++;
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(stop - start);
+    return (duration.count() * 1e-6);
+}
+
+double ReiterOpenMP::RunTiled(float alpha, float beta, float gamma, int tileSteps)
+{
+    auto curData = CreateGrid(beta);
+    auto prevData = CreateGrid(beta);
+
+    // Each thread advances its bands in a private copy holding the band and
+    // a halo of two rows per step, since the mask reaches one row further
+    // than the update. The halo is recomputed redundantly by both neighbours.
+    m_TileSteps = tileSteps;
+    m_TileRows = std::max(GetEnvOption("REITER_TILE_ROWS", TILE_ROWS), 1);
+    int threads = omp_get_max_threads();
+    size_t localSize = ScratchSize();
+    auto scratch = std::shared_ptr<float>((float*)aligned_alloc(GRID_ALIGNMENT, 2 * threads * localSize * sizeof(float)), free);
+    size_t maskSize = (threads * localSize + GRID_ALIGNMENT - 1) / GRID_ALIGNMENT * GRID_ALIGNMENT;
+    auto scratchMask = std::shared_ptr<unsigned char>((unsigned char*)aligned_alloc(GRID_ALIGNMENT, maskSize), free);
+    memset(scratchMask.get(), 0, maskSize);
+
+    size_t iter = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    InitActiveBox(prevData.get(), nullptr, beta);
+
+    // Same persistent region as the per-step loop, with AdvanceBlock
+    // reporting the first step of the block that reached the edge.
+    bool stable = IsStable(prevData.get());
+    int window[4];
+    GetActiveWindow(&window[0], &window[1], &window[2], &window[3], tileSteps);
+    int steps = std::min((size_t)tileSteps, MAX_ITER + 1 - iter);
+    int edgeStep = steps + 1;
+
+    #pragma omp parallel
+    {
+        while(!stable && iter <= MAX_ITER)
+        {
+            AdvanceBlock(curData.get(), prevData.get(), scratch.get(), scratchMask.get(), window, steps, alpha, gamma, &edgeStep);
+
+            // The edge was reached inside the block. prevData still holds the
+            // block start, so replay up to that step to stop where the
+            // per-step loop would.
+            if (edgeStep < steps)
+            {
+                #pragma omp barrier
+                #pragma omp single
+                steps = edgeStep;
+
+                AdvanceBlock(curData.get(), prevData.get(), scratch.get(), scratchMask.get(), window, steps, alpha, gamma, &edgeStep);
+            }
+
+            #pragma omp single
+            {
+                curData.swap(prevData);
+                ExpandActiveBox(prevData.get(), nullptr, tileSteps);
+                iter += steps;
+
+                stable = edgeStep <= steps;
+                if (iter <= MAX_ITER)
+                {
+                    GetActiveWindow(&window[0], &window[1], &window[2], &window[3], tileSteps);
+                    steps = std::min((size_t)tileSteps, MAX_ITER + 1 - iter);
+                    edgeStep = steps + 1;
+                }
+            }
+        }
     }
     if(m_DebugFreq == DebugFreq::Last)
         LogState(prevData.get(), iter);
@@ -54,6 +158,338 @@ double ReiterOpenMP::RunSimulation(float alpha, float beta, float gamma)
     return (duration.count() * 1e-6);
 }
 
+size_t ReiterOpenMP::ScratchSize()
+{
+    // Rows of one band, its halo at full tile depth and the leading row
+    return (size_t)(m_TileRows + 4 * m_TileSteps + 1) * m_Pitch;
+}
+
+void ReiterOpenMP::AdvanceBlock(float* curData, float* prevData, float* scratch, unsigned char* scratchMask, int* window, int steps, float alpha, float gamma, int* edgeStep)
+{
+    // Called by every thread of the enclosing parallel region
+    int rowStart = window[0], rowEnd = window[1];
+    int colStart = window[2], colEnd = window[3];
+    int maskColStart = std::max(colStart - 1, 0);
+    int maskColEnd = std::min(colEnd + 1, m_Width);
+
+    int halo = 2 * steps;
+    int threads = omp_get_num_threads();
+    int bandRows = std::max(std::min(m_TileRows, (rowEnd - rowStart + threads - 1) / threads), 1);
+    int bandCount = (rowEnd - rowStart + bandRows - 1) / bandRows;
+    size_t localSize = ScratchSize();
+
+    int firstEdgeStep = steps + 1;
+    float* src0 = scratch + 2 * omp_get_thread_num() * localSize;
+    float* dst0 = src0 + localSize;
+    unsigned char* mask = scratchMask + omp_get_thread_num() * localSize;
+
+    #pragma omp for schedule(dynamic) nowait
+    for (int b = 0; b < bandCount; b++)
+    {
+        int first = rowStart + b * bandRows;
+        int last = std::min(first + bandRows, rowEnd);
+
+        // Local row i sits at (i - loadStart + 1) * m_Pitch; the leading
+        // row carries the ghost column of row loadStart.
+        int loadStart = std::max(first - halo, -1);
+        int loadEnd = std::min(last + halo, m_Height + 1);
+        size_t loadSize = (size_t)(loadEnd - loadStart + 1) * m_Pitch;
+        memcpy(src0, prevData + CellIndex(loadStart, 0) - m_Pitch, loadSize * sizeof(float));
+        memcpy(dst0, src0, loadSize * sizeof(float));
+
+        float* src = src0;
+        float* dst = dst0;
+        for (int t = 0; t < steps; t++)
+        {
+            int reach = 2 * (steps - 1 - t);
+            int updStart = std::max(first - reach, rowStart);
+            int updEnd = std::min(last + reach, rowEnd);
+
+            for (int i = updStart - 1; i < updEnd + 1; i++)
+            {
+                size_t rowId = (size_t)(i - loadStart + 1) * m_Pitch;
+                UpdateMaskRow(src + rowId, mask + rowId, m_Pitch, maskColStart, maskColEnd);
+            }
+            for (int i = updStart; i < updEnd; i++)
+            {
+                size_t rowId = (size_t)(i - loadStart + 1) * m_Pitch;
+                UpdateRowCells(dst + rowId, src + rowId, mask + rowId, m_Pitch, colStart, colEnd, alpha, gamma);
+            }
+            std::swap(src, dst);
+
+            // Rows outside the window keep their block start values, so
+            // the owned rows are the only place the edge can be reached
+            for (int i = first; i < last && t + 1 < firstEdgeStep; i++)
+                if (EdgeReached(src + (size_t)(i - loadStart + 1) * m_Pitch, i))
+                    firstEdgeStep = t + 1;
+        }
+
+        for (int i = first; i < last; i++)
+            memcpy(curData + CellIndex(i, colStart), src + (size_t)(i - loadStart + 1) * m_Pitch + colStart, (colEnd - colStart) * sizeof(float));
+    }
+
+    #pragma omp critical
+    *edgeStep = std::min(*edgeStep, firstEdgeStep);
+
+    #pragma omp barrier
+}
+
+double ReiterOpenMP::RunDataflow(float alpha, float beta, float gamma)
+{
+    // REITER_DATAFLOW_BUFFERS grids are cycled through, so a tile can get
+    // that many steps less one ahead of the edge check and still hold the
+    // step the run ends on
+    m_FlowBuffers = std::max(GetEnvOption("REITER_DATAFLOW_BUFFERS", DATAFLOW_BUFFERS), 2);
+    std::vector<std::shared_ptr<float>> grids;
+    m_FlowData.clear();
+    for (int b = 0; b < m_FlowBuffers; b++)
+    {
+        grids.push_back(CreateGrid(beta));
+        m_FlowData.push_back(grids.back().get());
+    }
+
+    // Tiles are kept small, since a tile next to any activity is updated
+    // whole
+    m_TileRows = std::max(GetEnvOption("REITER_TILE_ROWS", DATAFLOW_TILE_ROWS), 2);
+    m_TileCols = (std::max(GetEnvOption("REITER_TILE_COLS", DATAFLOW_TILE_COLS), 1) + 15) / 16 * 16;
+    BuildFlowTiles();
+
+    // Each thread recomputes the mask of the tile it runs and the rows
+    // around it, as in the tiled path
+    int threads = omp_get_max_threads();
+    m_FlowMaskSize = ((size_t)(m_TileRows + 3) * m_Pitch + GRID_ALIGNMENT - 1) / GRID_ALIGNMENT * GRID_ALIGNMENT;
+    auto mask = std::shared_ptr<unsigned char>((unsigned char*)aligned_alloc(GRID_ALIGNMENT, threads * m_FlowMaskSize), free);
+    memset(mask.get(), 0, threads * m_FlowMaskSize);
+    m_FlowMask = mask.get();
+
+    m_BorderChecks.reset(new std::atomic<int>[m_FlowBuffers + 1]);
+    for (int k = 0; k <= m_FlowBuffers; k++)
+        m_BorderChecks[k] = 0;
+
+    m_FlowAlpha = alpha;
+    m_Gamma = gamma;
+    m_Beta = beta;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // A tile is left alone until it or a neighbour holds a cell other than
+    // beta, since until then its cells are beta in every buffer
+    float* data = m_FlowData[0];
+    for (int t = 0; t < m_FlowTileCount; t++)
+    {
+        FlowTile& tile = m_FlowTiles[t];
+        tile.activeSince = INT_MAX;
+        for (int i = tile.rowStart; i < tile.rowEnd && tile.activeSince != 0; i++)
+        {
+            float* rowData = data + CellIndex(i, 0);
+            for (int j = tile.colStart; j < tile.colEnd; j++)
+                if (rowData[j] != beta)
+                    tile.activeSince = 0;
+        }
+    }
+
+    m_ClearedStep = 0;
+    m_StopStep = (IsStable(data) ? 0 : MAX_ITER + 1);
+
+    // Tiles are advanced by tasks that spawn their neighbours as they
+    // become ready, so the end of the region is the only barrier
+    #pragma omp parallel
+    #pragma omp single
+    for (int t = 0; t < m_FlowTileCount; t++)
+    {
+        if (ClaimFlowTile(t))
+        {
+            #pragma omp task firstprivate(t)
+            RunFlowTile(t);
+        }
+    }
+
+    size_t iter = m_StopStep;
+    if(m_DebugFreq == DebugFreq::Last)
+        LogState(m_FlowData[iter % m_FlowBuffers], iter);
+
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(stop - start);
+    return (duration.count() * 1e-6);
+}
+
+void ReiterOpenMP::BuildFlowTiles()
+{
+    // Tiles cover the updated cells. A tile is at least two cells across
+    // in both directions, so everything a step reads lies in it and the
+    // eight tiles around it.
+    auto split = [](int lo, int hi, int size){
+        std::vector<int> bounds;
+        for (int b = lo; b < hi; b += size)
+            bounds.push_back(b);
+        if (bounds.size() > 1 && hi - bounds.back() < 2)
+            bounds.pop_back();
+        bounds.push_back(hi);
+        return bounds;
+    };
+
+    auto rows = split(1, m_Height - 1, m_TileRows);
+    auto cols = split(1, m_Width - 1, m_TileCols);
+    int rowCount = rows.size() - 1;
+    int colCount = cols.size() - 1;
+
+    m_FlowTileCount = std::max(rowCount, 0) * std::max(colCount, 0);
+    m_FlowTiles.reset(new FlowTile[m_FlowTileCount]);
+    m_BorderTileCount = 0;
+
+    for (int r = 0; r < rowCount; r++)
+    {
+        for (int c = 0; c < colCount; c++)
+        {
+            FlowTile& tile = m_FlowTiles[r * colCount + c];
+            tile.rowStart = rows[r];
+            tile.rowEnd = rows[r + 1];
+            tile.colStart = cols[c];
+            tile.colEnd = cols[c + 1];
+            tile.border = (r == 0 || c == 0 || r == rowCount - 1 || c == colCount - 1);
+            m_BorderTileCount += tile.border;
+
+            tile.neighbourCount = 0;
+            for (int dr = -1; dr <= 1; dr++)
+                for (int dc = -1; dc <= 1; dc++)
+                    if ((dr != 0 || dc != 0) && r + dr >= 0 && r + dr < rowCount && c + dc >= 0 && c + dc < colCount)
+                        tile.neighbours[tile.neighbourCount++] = (r + dr) * colCount + c + dc;
+        }
+    }
+}
+
+bool ReiterOpenMP::ClaimFlowTile(int t)
+{
+    // A tile takes its next step once its neighbours are at that step, so
+    // the cells it reads are there and the buffer it writes is no longer
+    // read. It also stays within the buffers of the steps every border tile
+    // has checked, so it never overwrites the step the run ends on.
+    FlowTile& tile = m_FlowTiles[t];
+    int step = tile.done;
+    if (step >= m_StopStep)
+        return false;
+
+    for (int n = 0; n < tile.neighbourCount; n++)
+        if (m_FlowTiles[tile.neighbours[n]].done < step)
+            return false;
+
+    // The flag is raised before looking again, so a border tile that
+    // clears the step in between sees it
+    if (m_ClearedStep < step - m_FlowBuffers + 1)
+    {
+        tile.waitingClear = true;
+        if (m_ClearedStep < step - m_FlowBuffers + 1)
+            return false;
+        tile.waitingClear = false;
+    }
+
+    // An edge is recorded in m_StopStep before the step is counted as
+    // cleared, so the stop step has to be read again after the cleared one
+    if (step >= m_StopStep)
+        return false;
+
+    return tile.claimed.compare_exchange_strong(step, step + 1);
+}
+
+void ReiterOpenMP::RunFlowTile(int t)
+{
+    // Keeps advancing the tile while it stays ready
+    do
+    {
+        bool cleared = StepFlowTile(t);
+        WakeFlowTiles(t, cleared);
+    } while (ClaimFlowTile(t));
+}
+
+bool ReiterOpenMP::StepFlowTile(int t)
+{
+    FlowTile& tile = m_FlowTiles[t];
+    int step = tile.done;
+    float* src = m_FlowData[step % m_FlowBuffers];
+    float* dst = m_FlowData[(step + 1) % m_FlowBuffers];
+
+    bool awake = tile.activeSince <= step;
+    for (int n = 0; n < tile.neighbourCount; n++)
+        awake = awake || m_FlowTiles[tile.neighbours[n]].activeSince <= step;
+
+    if (awake)
+    {
+        unsigned char* mask = m_FlowMask + omp_get_thread_num() * m_FlowMaskSize;
+        int maskColStart = std::max(tile.colStart - 1, 0);
+        int maskColEnd = std::min(tile.colEnd + 1, m_Width);
+
+        for (int i = tile.rowStart - 1; i < tile.rowEnd + 1; i++)
+            UpdateMaskRow(src + CellIndex(i, 0), mask + (size_t)(i - tile.rowStart + 1) * m_Pitch, m_Pitch, maskColStart, maskColEnd);
+        for (int i = tile.rowStart; i < tile.rowEnd; i++)
+            UpdateRowCells(dst + CellIndex(i, 0), src + CellIndex(i, 0), mask + (size_t)(i - tile.rowStart + 1) * m_Pitch, m_Pitch, tile.colStart, tile.colEnd, m_FlowAlpha, m_Gamma);
+
+        for (int i = tile.rowStart; i < tile.rowEnd && tile.activeSince == INT_MAX; i++)
+        {
+            float* rowData = dst + CellIndex(i, 0);
+            for (int j = tile.colStart; j < tile.colEnd; j++)
+                if (rowData[j] != m_Beta)
+                    tile.activeSince = step + 1;
+        }
+    }
+
+    bool cleared = false;
+    if (tile.border)
+    {
+        if (awake && EdgeReachedInBox(dst, tile.rowStart, tile.rowEnd, tile.colStart, tile.colEnd))
+        {
+            int stop = m_StopStep;
+            while (stop > step + 1 && !m_StopStep.compare_exchange_weak(stop, step + 1));
+        }
+        cleared = ReportBorderStep(step + 1);
+    }
+
+    tile.done = step + 1;
+    return cleared;
+}
+
+void ReiterOpenMP::WakeFlowTiles(int t, bool cleared)
+{
+    FlowTile& tile = m_FlowTiles[t];
+    for (int n = 0; n < tile.neighbourCount; n++)
+    {
+        int other = tile.neighbours[n];
+        if (ClaimFlowTile(other))
+        {
+            #pragma omp task firstprivate(other)
+            RunFlowTile(other);
+        }
+    }
+
+    if (!cleared)
+        return;
+
+    for (int other = 0; other < m_FlowTileCount; other++)
+    {
+        if (other != t && m_FlowTiles[other].waitingClear.exchange(false) && ClaimFlowTile(other))
+        {
+            #pragma omp task firstprivate(other)
+            RunFlowTile(other);
+        }
+    }
+}
+
+bool ReiterOpenMP::ReportBorderStep(int step)
+{
+    // Counts the border tiles that have checked the step. Counters are
+    // reused every m_FlowBuffers + 1 steps, which is further than border
+    // tiles can drift apart, and the last one in advances m_ClearedStep.
+    auto& checks = m_BorderChecks[step % (m_FlowBuffers + 1)];
+    if ((checks.fetch_add(1) + 1) % m_BorderTileCount != 0)
+        return false;
+
+    checks.fetch_sub(m_BorderTileCount);
+    int cleared = m_ClearedStep;
+    while (cleared < step && !m_ClearedStep.compare_exchange_weak(cleared, step));
+    return true;
+}
+
+#ifndef REITER_NO_MAIN
 int main(int argc, char** argv){
 
     int width, height;
@@ -71,4 +507,5 @@ int main(int argc, char** argv){
     printf("{\"type\": \"OpenMP\", \"n\": %d, \"elapsed\": %lf, \"width\": %d, \"height\": %d, \"alpha\": %f, \"beta\": %f, \"gamma\": %f},\n",omp_get_max_threads(), dur, width, height, alpha, beta, gamma);
 
     return 0;
-}
\ No newline at end of file
+}
+#endif
@@ -2,9 +2,57 @@
 
 #include "ReiterSim.h"
 
+#include <atomic>
+
 class ReiterOpenMP : public ReiterSimulation{
     public:
         ReiterOpenMP(int width, int height) : ReiterSimulation(width, height) {};
 
         virtual double RunSimulation(float alpha, float beta, float gamma) override;
+
+    private:
+        double RunTiled(float alpha, float beta, float gamma, int tileSteps);
+        void AdvanceBlock(float* curData, float* prevData, float* scratch, unsigned char* scratchMask, int* window, int steps, float alpha, float gamma, int* edgeStep);
+        size_t ScratchSize();
+
+        double RunDataflow(float alpha, float beta, float gamma);
+        void BuildFlowTiles();
+        bool ClaimFlowTile(int tile);
+        void RunFlowTile(int tile);
+        bool StepFlowTile(int tile);
+        void WakeFlowTiles(int tile, bool cleared);
+        bool ReportBorderStep(int step);
+
+        int m_TileSteps = 1;
+        int m_TileRows = 1;
+        int m_TileCols = 1;
+
+        // A tile of the dataflow executor. done is the step its cells are at,
+        // claimed runs one ahead of it while a task is advancing the tile.
+        struct FlowTile {
+            int rowStart, rowEnd;
+            int colStart, colEnd;
+            bool border;
+            int neighbours[8];
+            int neighbourCount;
+            std::atomic<int> done{0};
+            std::atomic<int> claimed{0};
+            std::atomic<int> activeSince{0};
+            std::atomic<bool> waitingClear{false};
+        };
+
+        std::unique_ptr<FlowTile[]> m_FlowTiles;
+        int m_FlowTileCount = 0;
+        int m_BorderTileCount = 0;
+        std::vector<float*> m_FlowData;
+        int m_FlowBuffers = 2;
+        unsigned char* m_FlowMask = nullptr;
+        size_t m_FlowMaskSize = 0;
+        float m_FlowAlpha = 0;
+
+        // Steps up to m_ClearedStep have been checked by every border tile,
+        // and m_StopStep is the step the run ends on as far as known yet
+        std::unique_ptr<std::atomic<int>[]> m_BorderChecks;
+        std::atomic<int> m_ClearedStep{0};
+        std::atomic<int> m_StopStep{0};
 };
\ No newline at end of file
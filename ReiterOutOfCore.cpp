@@ -0,0 +1,278 @@
+#include "ReiterOutOfCore.h"
+
+#include <chrono>
+#include <algorithm>
+#include <fstream>
+#include <typeinfo>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define BAND_ROWS 64
+#define SCRATCH_DIR "."
+
+double ReiterOutOfCore::RunSimulation(float alpha, float beta, float gamma)
+{
+    // Both grids, the mask and the interior cells live in files under
+    // REITER_SCRATCH_DIR, which should be on local NVMe, and are swept
+    // REITER_BAND_ROWS rows at a time
+    const char* dir = getenv("REITER_SCRATCH_DIR");
+    m_ScratchDir = (dir != nullptr && *dir != '\0' ? dir : SCRATCH_DIR);
+    m_BandRows = std::max(GetEnvOption("REITER_BAND_ROWS", BAND_ROWS), 1);
+
+    auto curData = MapGrid(beta);
+    auto prevData = MapGrid(beta);
+    auto mask = MapFile((GridStorageSize() + GRID_ALIGNMENT - 1) / GRID_ALIGNMENT * GRID_ALIGNMENT);
+    m_InteriorFile = MapFile(GridStorageSize() * sizeof(InteriorRecord));
+
+    size_t iter = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    InitReceptiveFrontier((float*)prevData->data, (unsigned char*)mask->data, alpha, beta, gamma);
+    InitActiveBox((float*)prevData->data, (unsigned char*)mask->data, beta);
+
+    // As in the OpenMP loop the edge check is done on the rows as they are
+    // updated, so IsStable does not touch a page of every row each step
+    bool stable = IsStable((float*)prevData->data);
+    while(!stable && iter <= MAX_ITER)
+    {
+        int rowStart, rowEnd, colStart, colEnd;
+        GetActiveWindow(&rowStart, &rowEnd, &colStart, &colEnd);
+
+        stable = SweepBands(*curData, *prevData, *mask, rowStart, rowEnd, colStart, colEnd, alpha, gamma);
+
+        if(m_DebugFreq == DebugFreq::EveryIter){
+            MaterializeBands(*curData, *mask, iter + 1);
+            LogBands((float*)curData->data, iter);
+        }
+
+        // Without monotone growth the sweep has already refreshed the mask
+        // behind it, which is all AdvanceReceptiveFrontier would do
+        curData.swap(prevData);
+        if (m_MonotoneGrowth)
+            AdvanceReceptiveFrontier((float*)prevData->data, (unsigned char*)mask->data);
+        else
+            m_Step++;
+        GrowActiveBox((float*)prevData->data, (unsigned char*)mask->data);
+        iter++;
+    }
+    if(m_DebugFreq == DebugFreq::Last){
+        MaterializeBands(*prevData, *mask, iter);
+        LogBands((float*)prevData->data, iter);
+    }
+
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    m_InteriorFile.reset();
+
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(stop - start);
+    return (duration.count() * 1e-6);
+}
+
+std::shared_ptr<ReiterOutOfCore::MappedFile> ReiterOutOfCore::MapFile(size_t size)
+{
+    // The file is unlinked as soon as it exists, so it goes away with the
+    // mapping. A new file reads as zeros, which are the ghost cells and the
+    // empty mask.
+    std::string path = m_ScratchDir + "/ReiterOutOfCoreXXXXXX";
+    int fd = mkstemp(&path[0]);
+    if (fd < 0 || unlink(path.c_str()) != 0 || ftruncate(fd, size) != 0)
+    {
+        perror(path.c_str());
+        exit(-1);
+    }
+
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED)
+    {
+        perror("mmap");
+        exit(-1);
+    }
+
+    return std::shared_ptr<MappedFile>(new MappedFile{(char*)data, size, fd}, [](MappedFile* file){
+        munmap(file->data, file->size);
+        close(file->fd);
+        delete file;
+    });
+}
+
+std::shared_ptr<ReiterOutOfCore::MappedFile> ReiterOutOfCore::MapGrid(float beta)
+{
+    // CreateGrid written out band by band
+    auto grid = MapFile(GridStorageSize() * sizeof(float));
+    float* data = (float*)grid->data;
+
+    for (int first = 0; first < m_Height; first += m_BandRows)
+    {
+        int last = std::min(first + m_BandRows, m_Height);
+        for (int i = first; i < last; i++)
+            for (int j = 0; j < m_Width; j++)
+                data[CellIndex(i, j)] = InitialCell(i, j, beta);
+
+        WriteBehind(*grid, sizeof(float), first, last);
+    }
+
+    return grid;
+}
+
+void ReiterOutOfCore::RowRange(const MappedFile& file, size_t cellSize, int rowFirst, int rowLast, size_t* offset, size_t* length)
+{
+    // Bytes of the rows, widened to whole pages and clipped to the file
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t first = CellIndex(std::max(rowFirst, -2), 0) * cellSize / page * page;
+    size_t last = std::min(CellIndex(std::min(rowLast, m_Height + 1), 0) * cellSize, file.size);
+
+    *offset = first;
+    *length = (last > first ? last - first : 0);
+}
+
+void ReiterOutOfCore::PrefetchRows(const MappedFile& file, size_t cellSize, int rowFirst, int rowLast)
+{
+    // Starts readahead of the rows without waiting for it
+    size_t offset, length;
+    RowRange(file, cellSize, rowFirst, rowLast, &offset, &length);
+    if (length > 0)
+        madvise(file.data + offset, length, MADV_WILLNEED);
+}
+
+void ReiterOutOfCore::WriteBehind(const MappedFile& file, size_t cellSize, int rowFirst, int rowLast)
+{
+    // Starts writeback of the dirty pages of the rows without waiting for
+    // it, so they are clean and cheap to evict by the time memory runs out
+    size_t offset, length;
+    RowRange(file, cellSize, rowFirst, rowLast, &offset, &length);
+    if (length > 0)
+        sync_file_range(file.fd, offset, length, SYNC_FILE_RANGE_WRITE);
+}
+
+bool ReiterOutOfCore::SweepBands(const MappedFile& cur, const MappedFile& prev, const MappedFile& mask, int rowStart, int rowEnd, int colStart, int colEnd, float alpha, float gamma)
+{
+    // The next band is read ahead while one is updated, and every updated
+    // band of the new grid is written back behind the sweep. A band reads
+    // the rows next to it from the old grid and the mask. Without monotone
+    // growth the mask rows the sweep has left behind are refreshed from the
+    // new grid as it goes.
+    float* curData = (float*)cur.data;
+    float* prevData = (float*)prev.data;
+    unsigned char* maskData = (unsigned char*)mask.data;
+    bool edgeReached = false;
+
+    PrefetchRows(prev, sizeof(float), rowStart - 1, std::min(rowStart + m_BandRows, rowEnd) + 1);
+    PrefetchRows(mask, sizeof(unsigned char), rowStart - 1, std::min(rowStart + m_BandRows, rowEnd) + 1);
+
+    for (int first = rowStart; first < rowEnd; first += m_BandRows)
+    {
+        int last = std::min(first + m_BandRows, rowEnd);
+        int next = std::min(last + m_BandRows, rowEnd);
+        if (last < next)
+        {
+            PrefetchRows(prev, sizeof(float), last + 1, next + 1);
+            PrefetchRows(mask, sizeof(unsigned char), last + 1, next + 1);
+            PrefetchRows(cur, sizeof(float), last, next);
+        }
+
+        for (int i = first; i < last; i++)
+        {
+            UpdateRow(curData, prevData, maskData, i, colStart, colEnd, alpha, gamma);
+            edgeReached = edgeReached || EdgeReached(curData + CellIndex(i, 0), i);
+        }
+
+        WriteBehind(cur, sizeof(float), first, last);
+
+        if (!m_MonotoneGrowth)
+        {
+            UpdateReceptiveMask(curData, maskData, std::max(first - 1, 0), last - 1);
+            WriteBehind(mask, sizeof(unsigned char), first - 1, last - 1);
+        }
+    }
+
+    // Rows outside the window keep their values, so only the mask rows
+    // next to it can change
+    if (!m_MonotoneGrowth && rowStart < rowEnd)
+    {
+        UpdateReceptiveMask(curData, maskData, std::max(rowEnd - 1, 0), std::min(rowEnd + 1, m_Height));
+        WriteBehind(mask, sizeof(unsigned char), rowEnd - 1, rowEnd + 1);
+    }
+
+    return edgeReached;
+}
+
+void ReiterOutOfCore::RecordInteriorCell(float* data, size_t cellId)
+{
+    ((InteriorRecord*)m_InteriorFile->data)[cellId] = {(unsigned int)m_Step, data[cellId]};
+}
+
+void ReiterOutOfCore::MaterializeBands(const MappedFile& grid, const MappedFile& mask, size_t step)
+{
+    // MaterializeInterior in row order over the window, which holds every
+    // interior cell, so the grid and the records are read sequentially
+    float* data = (float*)grid.data;
+    unsigned char* maskData = (unsigned char*)mask.data;
+    InteriorRecord* records = (InteriorRecord*)m_InteriorFile->data;
+
+    int rowStart, rowEnd, colStart, colEnd;
+    GetActiveWindow(&rowStart, &rowEnd, &colStart, &colEnd);
+
+    for (int first = rowStart; first < rowEnd; first += m_BandRows)
+    {
+        int last = std::min(first + m_BandRows, rowEnd);
+        int next = std::min(last + m_BandRows, rowEnd);
+        if (last < next)
+        {
+            PrefetchRows(mask, sizeof(unsigned char), last, next);
+            PrefetchRows(*m_InteriorFile, sizeof(InteriorRecord), last, next);
+        }
+
+        for (int i = first; i < last; i++)
+        {
+            size_t rowId = CellIndex(i, 0);
+            for (int j = colStart; j < colEnd; j++)
+            {
+                size_t cellId = rowId + j;
+                if (maskData[cellId] & CELL_INTERIOR)
+                    data[cellId] = records[cellId].value + m_Gamma * (step - records[cellId].step);
+            }
+        }
+
+        WriteBehind(grid, sizeof(float), first, last);
+    }
+}
+
+void ReiterOutOfCore::LogBands(float* data, size_t iter)
+{
+    // Raw snapshots are streamed from the mapping a row at a time, the other
+    // formats go through the dense copy of LogState and need the grid to fit
+    if (m_DebugFreq == DebugFreq::None || m_DebugMode != DebugType::Raw)
+    {
+        LogState(data, iter);
+        return;
+    }
+
+    std::ofstream file(std::string(typeid(*this).name()) + std::to_string(iter) + std::string(".bin"), std::ios::binary);
+
+    int header[2] = {m_Width, m_Height};
+    file.write((const char*)header, sizeof(header));
+    for (int i = 0; i < m_Height; i++)
+        file.write((const char*)(data + CellIndex(i, 0)), m_Width * sizeof(float));
+
+    file.close();
+}
+
+int main(int argc, char** argv){
+
+    int width, height;
+    float alpha, beta, gamma;
+
+    if (!ReiterSimulation::ParseInputParams(argc, argv, &width, &height, &alpha, &beta, &gamma))
+    {
+        printf("Correct usage should be: %s <width> <height> <alpha> <beta> <gamma>\n", argv[0]);
+        return -1;
+    }
+
+    ReiterOutOfCore model(width, height);
+    auto dur = model.RunSimulation(alpha, beta, gamma);
+
+    printf("{\"type\": \"OutOfCore\", \"elapsed\": %lf, \"width\": %d, \"height\": %d, \"alpha\": %f, \"beta\": %f, \"gamma\": %f},\n", dur, width, height, alpha, beta, gamma);
+
+    return 0;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "ReiterSim.h"
+
+class ReiterOutOfCore : public ReiterSimulation{
+    public:
+        ReiterOutOfCore(int width, int height) : ReiterSimulation(width, height) { m_DebugMode = DebugType::Raw; };
+
+        virtual double RunSimulation(float alpha, float beta, float gamma) override;
+
+    protected:
+        virtual void RecordInteriorCell(float* data, size_t cellId) override;
+
+    private:
+        // A scratch file mapped shared, so the kernel pages the grid in and
+        // out of it instead of swap
+        struct MappedFile {
+            char* data;
+            size_t size;
+            int fd;
+        };
+
+        // The closed form of an interior cell, kept at the index of the cell
+        struct InteriorRecord {
+            unsigned int step;
+            float value;
+        };
+
+        std::shared_ptr<MappedFile> MapFile(size_t size);
+        std::shared_ptr<MappedFile> MapGrid(float beta);
+        void RowRange(const MappedFile& file, size_t cellSize, int rowFirst, int rowLast, size_t* offset, size_t* length);
+        void PrefetchRows(const MappedFile& file, size_t cellSize, int rowFirst, int rowLast);
+        void WriteBehind(const MappedFile& file, size_t cellSize, int rowFirst, int rowLast);
+        bool SweepBands(const MappedFile& cur, const MappedFile& prev, const MappedFile& mask, int rowStart, int rowEnd, int colStart, int colEnd, float alpha, float gamma);
+        void MaterializeBands(const MappedFile& grid, const MappedFile& mask, size_t step);
+        void LogBands(float* data, size_t iter);
+
+        std::string m_ScratchDir;
+        int m_BandRows = 1;
+        std::shared_ptr<MappedFile> m_InteriorFile;
+};
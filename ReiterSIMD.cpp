@@ -0,0 +1,63 @@
+#include "ReiterSIMD.h"
+
+#include <chrono>
+
+double ReiterSIMD::RunSimulation(float alpha, float beta, float gamma)
+{
+    auto curData = CreateGrid(beta);
+    auto prevData = CreateGrid(beta);
+    auto mask = CreateMask();
+
+    size_t iter = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    InitReceptiveFrontier(prevData.get(), mask.get(), alpha, beta, gamma);
+    InitActiveBox(prevData.get(), mask.get(), beta);
+    while(!IsStable(prevData.get()) && iter <= MAX_ITER)
+    {
+        int rowStart, rowEnd, colStart, colEnd;
+        GetActiveWindow(&rowStart, &rowEnd, &colStart, &colEnd);
+
+        for (int i = rowStart; i < rowEnd; i++)
+            UpdateRow(curData.get(), prevData.get(), mask.get(), i, colStart, colEnd, alpha, gamma);
+
+        if(m_DebugFreq == DebugFreq::EveryIter){
+            MaterializeInterior(curData.get(), iter + 1);
+            LogState(curData.get(), iter);
+        }
+
+        curData.swap(prevData);
+        AdvanceReceptiveFrontier(prevData.get(), mask.get());
+        GrowActiveBox(prevData.get(), mask.get());
+        iter++;
+    }
+    if(m_DebugFreq == DebugFreq::Last){
+        MaterializeInterior(prevData.get(), iter);
+        LogState(prevData.get(), iter);
+    }
+
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(stop - start);
+
+    return (duration.count() * 1e-6);
+}
+
+int main(int argc, char** argv){
+
+    int width, height;
+    float alpha, beta, gamma;
+
+    if (!ReiterSimulation::ParseInputParams(argc, argv, &width, &height, &alpha, &beta, &gamma))
+    {
+        printf("Correct usage should be: %s <width> <height> <alpha> <beta> <gamma>\n", argv[0]);
+        return -1;
+    }
+
+    ReiterSIMD model(width, height);
+    auto dur = model.RunSimulation(alpha, beta, gamma);
+
+    printf("{\"type\": \"SIMD\", \"elapsed\": %lf, \"width\": %d, \"height\": %d, \"alpha\": %f, \"beta\": %f, \"gamma\": %f},\n", dur, width, height, alpha, beta, gamma);
+
+    return 0;
+}
\ No newline at end of file
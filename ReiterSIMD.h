@@ -0,0 +1,10 @@
+#pragma once
+
+#include "ReiterSim.h"
+
+class ReiterSIMD : public ReiterSimulation{
+    public:
+        ReiterSIMD(int width, int height) : ReiterSimulation(width, height) { m_Layout = GridLayout::SplitParity; };
+
+        virtual double RunSimulation(float alpha, float beta, float gamma) override;
+};
\ No newline at end of file
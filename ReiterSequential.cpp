@@ -6,30 +6,36 @@ double ReiterSequential::RunSimulation(float alpha, float beta, float gamma)
 {
     auto curData = CreateGrid(beta);
     auto prevData = CreateGrid(beta);
+    auto mask = CreateMask();
 
     auto idArray = std::shared_ptr<size_t>((size_t*)malloc(6 * sizeof(size_t)), free);
     size_t iter = 0;
 
     auto start = std::chrono::high_resolution_clock::now();
+    InitReceptiveFrontier(prevData.get(), mask.get(), alpha, beta, gamma);
+    InitActiveBox(prevData.get(), mask.get(), beta);
     while(!IsStable(prevData.get()) && iter <= MAX_ITER)
     {
-        for (int i = 0; i < m_Height; i++)
+        int rowStart, rowEnd, colStart, colEnd;
+        GetActiveWindow(&rowStart, &rowEnd, &colStart, &colEnd);
+
+        for (int i = rowStart; i < rowEnd; i++)
         {
-            for (int j = 0; j < m_Width; j++)
+            for (int j = colStart; j < colEnd; j++)
             {
-                if(i == 0 || j == 0 || m_Height - i == 1 || m_Width - j == 1)
+                size_t cellId = CellIndex(i, j);
+                if (mask.get()[cellId] & CELL_INTERIOR)
                     continue;
-                
-                int cellId = m_Width * i + j;
+
                 GetNeighbourCellIds(cellId, idArray.get());
                 float sum = 0;
                 for (int k = 0; k < 6; k++){
-                    int id = idArray.get()[k];
-                    if (!CheckReceptiveCell(prevData.get(), id))
+                    size_t id = idArray.get()[k];
+                    if (!(mask.get()[id] & CELL_RECEPTIVE))
                         sum += prevData.get()[id];
                 }
                 
-                float cellR = (CheckReceptiveCell(prevData.get(), cellId) ? 1.0 : 0.0);
+                float cellR = ((mask.get()[cellId] & CELL_RECEPTIVE) ? 1.0 : 0.0);
                 float cellU = (cellR == 0.0 ? prevData.get()[cellId] : 0.0);
 
                 curData.get()[cellId] = prevData.get()[cellId] +  (alpha / 2.0) * ((sum / 6.0) - cellU) + (gamma * cellR);
@@ -37,14 +43,20 @@ double ReiterSequential::RunSimulation(float alpha, float beta, float gamma)
             
         }
         
-        if(m_DebugFreq == DebugFreq::EveryIter)
+        if(m_DebugFreq == DebugFreq::EveryIter){
+            MaterializeInterior(curData.get(), iter + 1);
             LogState(curData.get(), iter);
+        }
 
         curData.swap(prevData);
+        AdvanceReceptiveFrontier(prevData.get(), mask.get());
+        GrowActiveBox(prevData.get(), mask.get());
         iter++;
     }
-    if(m_DebugFreq == DebugFreq::Last)
+    if(m_DebugFreq == DebugFreq::Last){
+        MaterializeInterior(prevData.get(), iter);
         LogState(prevData.get(), iter);
+    }
 
     auto stop = std::chrono::high_resolution_clock::now();
 
@@ -3,9 +3,17 @@
 #include "lib/FreeImage.h"
 
 #include <vector>
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 
 bool ReiterSimulation::ParseInputParams(int argc, char** argv, int* width, int* height, float* alpha, float* beta, float* gamma)
@@ -22,40 +30,214 @@ bool ReiterSimulation::ParseInputParams(int argc, char** argv, int* width, int*
     return true;
 }
 
+bool ReiterSimulation::ReadParamSets(const char* filename, std::vector<ParamSet>* sets)
+{
+    // One set per line in the order of the command line arguments, "-" reads
+    // standard input. Empty lines and lines starting with # are skipped.
+    std::ifstream file;
+    if (std::string(filename) != "-")
+    {
+        file.open(filename);
+        if (!file.is_open())
+            return false;
+    }
+    std::istream& input = (file.is_open() ? file : std::cin);
+
+    std::string line;
+    while (std::getline(input, line))
+    {
+        std::istringstream tokens(line);
+        std::vector<std::string> args = {filename};
+        for (std::string token; tokens >> token; )
+            args.push_back(token);
+        if (args.size() == 1 || args[1][0] == '#')
+            continue;
+
+        std::vector<char*> argv;
+        for (auto& arg : args)
+            argv.push_back(&arg[0]);
+
+        ParamSet set;
+        if (!ParseInputParams(argv.size(), argv.data(), &set.width, &set.height, &set.alpha, &set.beta, &set.gamma))
+            return false;
+        sets->push_back(set);
+    }
+
+    return true;
+}
+
+int ReiterSimulation::GetEnvOption(const char* name, int defaultValue)
+{
+    const char* value = getenv(name);
+    if (value == nullptr || *value == '\0')
+        return defaultValue;
+
+    return atoi(value);
+}
+
+int ReiterSimulation::GridPitch(int width)
+{
+    // One ghost column on each side, rounded up to a whole number of cache lines
+    int align = GRID_ALIGNMENT / sizeof(float);
+    return (width + 2 + align - 1) / align * align;
+}
+
+void ReiterSimulation::SetGridSize(int width, int height)
+{
+    m_Width = width;
+    m_Height = height;
+    m_Pitch = GridPitch(width);
+}
+
+std::shared_ptr<void> ReiterSimulation::AllocateBuffer(size_t size)
+{
+    // A buffer is handed out again once the pool holds the only reference,
+    // so a model run many times, as in a sweep, allocates and faults in its
+    // grids once. Unused buffers of another size are from an earlier grid
+    // size and are dropped.
+    for (auto& buffer : m_BufferPool)
+        if (buffer.size == size && buffer.data.use_count() == 1)
+            return buffer.data;
+
+    m_BufferPool.erase(std::remove_if(m_BufferPool.begin(), m_BufferPool.end(), [&](const PooledBuffer& buffer){
+        return buffer.size != size && buffer.data.use_count() == 1;
+    }), m_BufferPool.end());
+
+    m_BufferPool.push_back({size, std::shared_ptr<void>(aligned_alloc(GRID_ALIGNMENT, size), free)});
+    return m_BufferPool.back().data;
+}
+
+size_t ReiterSimulation::GridStorageSize()
+{
+    // Ghost rows above and below the grid, plus one more row in front that
+    // holds the ghost column of the first ghost row.
+    return (size_t)(m_Height + 3) * m_Pitch;
+}
+
 std::shared_ptr<float> ReiterSimulation::CreateGrid(float beta)
 {
-    auto data = std::shared_ptr<float>((float*)malloc(m_Width * m_Height * sizeof(float)), free);
-    
-    for (int i = 0; i < m_Height * m_Width; i++)
-        data.get()[i] = beta;
+    // Ghost cells stay at 0 so they are never receptive and every neighbour
+    // read of a grid cell stays in bounds without checks.
+    auto data = std::static_pointer_cast<float>(AllocateBuffer(GridStorageSize() * sizeof(float)));
+    memset(data.get(), 0, GridStorageSize() * sizeof(float));
 
-    data.get()[(m_Height / 2) * m_Width + (m_Width / 2)] = 1;
+    for (int i = 0; i < m_Height; i++)
+        for (int j = 0; j < m_Width; j++)
+            data.get()[CellIndex(i, j)] = InitialCell(i, j, beta);
 
     return data;
 }
 
+float ReiterSimulation::InitialCell(int i, int j, float beta)
+{
+    // Vapour everywhere except a single frozen seed in the centre
+    return (i == m_Height / 2 && j == m_Width / 2 ? 1 : beta);
+}
+
+std::shared_ptr<unsigned char> ReiterSimulation::CreateMask()
+{
+    size_t size = (GridStorageSize() + GRID_ALIGNMENT - 1) / GRID_ALIGNMENT * GRID_ALIGNMENT;
+    auto mask = std::static_pointer_cast<unsigned char>(AllocateBuffer(size));
+    memset(mask.get(), 0, size);
+
+    return mask;
+}
+
 bool ReiterSimulation::IsStable(float* data)
 {
     for (int i = 1; i < m_Height - 1; i++){
-        if(data[i*m_Width + 1] >= 1)
+        if(data[CellIndex(i, 1)] >= 1)
             return true;
-        if(data[(i+1)*m_Width - 2] >= 1)
+        if(data[CellIndex(i, m_Width - 2)] >= 1)
             return true;
     }
 
     for (int i = 1; i < m_Width - 1; i++){
-        if(data[m_Width + i] >= 1)
+        if(data[CellIndex(1, i)] >= 1)
             return true;
-        if(data[(m_Height-2)*m_Width + i] >= 1)
+        if(data[CellIndex(m_Height - 2, i)] >= 1)
             return true;
     }
     return false;
 }
 
+bool ReiterSimulation::EdgeReached(float* rowData, int row)
+{
+    // The part of IsStable that falls on one row of the offset layout
+    if (row == 1 || row == m_Height - 2)
+    {
+        for (int j = 1; j < m_Width - 1; j++)
+            if (rowData[j] >= 1)
+                return true;
+        return false;
+    }
+
+    return row > 1 && row < m_Height - 2 && (rowData[1] >= 1 || rowData[m_Width - 2] >= 1);
+}
+
+bool ReiterSimulation::EdgeReachedInBox(float* data, int rowStart, int rowEnd, int colStart, int colEnd)
+{
+    // The part of IsStable that falls inside the box, for callers that
+    // update the grid a tile at a time
+    for (int i = rowStart; i < rowEnd; i++)
+    {
+        float* rowData = data + CellIndex(i, 0);
+        if (i == 1 || i == m_Height - 2)
+        {
+            for (int j = std::max(colStart, 1); j < std::min(colEnd, m_Width - 1); j++)
+                if (rowData[j] >= 1)
+                    return true;
+        }
+        else if (i > 1 && i < m_Height - 2)
+        {
+            if (colStart <= 1 && 1 < colEnd && rowData[1] >= 1)
+                return true;
+            if (colStart <= m_Width - 2 && m_Width - 2 < colEnd && rowData[m_Width - 2] >= 1)
+                return true;
+        }
+    }
+
+    return false;
+}
+
+size_t ReiterSimulation::CellIndex(int i, int j)
+{
+    // Rows are m_Pitch apart with column 0 on an aligned boundary; ghost rows
+    // -1 and m_Height and ghost columns -1 and m_Width are valid indices. Column
+    // -1 is the last padding slot of the row before. SplitParity
+    // keeps every row as its even columns, a ghost slot and its odd columns,
+    // which puts all six neighbours at fixed offsets per half-row.
+    size_t rowId = (size_t)(i + 2) * m_Pitch;
+
+    if (m_Layout == GridLayout::SplitParity)
+        return rowId + (j % 2 == 0 ? j / 2 : OddColumnOffset() + (j - 1) / 2);
+
+    return rowId + j;
+}
+
+void ReiterSimulation::CellCoords(size_t cellId, int* i, int* j)
+{
+    int k = cellId % m_Pitch;
+    *i = cellId / m_Pitch - 2;
+
+    if (m_Layout == GridLayout::SplitParity)
+    {
+        *j = (k < OddColumnOffset() ? 2 * k : 2 * (k - OddColumnOffset()) + 1);
+        return;
+    }
+
+    *j = k;
+}
+
+int ReiterSimulation::OddColumnOffset()
+{
+    return (m_Width + 1) / 2 + 1;
+}
+
 void ReiterSimulation::GetNeighbourCellIds(size_t cellId, size_t* outIdArray)
 {
-    size_t j = cellId % m_Width;
-    size_t i = (cellId - j) / m_Width;
+    int i, j;
+    CellCoords(cellId, &i, &j);
 
     int nOff;
     if (j%2 == 0)
@@ -63,12 +245,12 @@ void ReiterSimulation::GetNeighbourCellIds(size_t cellId, size_t* outIdArray)
     else
         nOff = 0;
         
-    outIdArray[0] = m_Width * (i-1) + j;
-    outIdArray[1] = m_Width * (nOff + i) + j - 1;
-    outIdArray[2] = m_Width * (nOff + i+1) + j - 1;
-    outIdArray[3] = m_Width * (nOff + i) + j + 1;
-    outIdArray[4] = m_Width * (nOff + i+1) + j + 1;
-    outIdArray[5] = m_Width * (i+1) + j;
+    outIdArray[0] = CellIndex(i-1, j);
+    outIdArray[1] = CellIndex(nOff + i, j - 1);
+    outIdArray[2] = CellIndex(nOff + i+1, j - 1);
+    outIdArray[3] = CellIndex(nOff + i, j + 1);
+    outIdArray[4] = CellIndex(nOff + i+1, j + 1);
+    outIdArray[5] = CellIndex(i+1, j);
 }
 
 bool ReiterSimulation::CheckReceptiveCell(float* data, size_t cellId)
@@ -76,8 +258,8 @@ bool ReiterSimulation::CheckReceptiveCell(float* data, size_t cellId)
     if(data[cellId] >= 1)
         return true;
 
-    int j = cellId % m_Width;
-    int i = (cellId - j) / m_Width;
+    int i, j;
+    CellCoords(cellId, &i, &j);
 
     int nOff;
     if (j%2 == 0)
@@ -85,27 +267,559 @@ bool ReiterSimulation::CheckReceptiveCell(float* data, size_t cellId)
     else
         nOff = 0;
         
-    if(i>0 && data[m_Width * (i-1) + j] >= 1)
+    if(data[CellIndex(i-1, j)] >= 1)
         return true;
-    if(j>0 && (nOff + i) > 0 && data[m_Width * (nOff + i) + j - 1] >= 1)
+    if(data[CellIndex(nOff + i, j - 1)] >= 1)
         return true;
-    if(j>0 && (nOff + i+1) < m_Height && data[m_Width * (nOff + i+1) + j - 1] >= 1)
+    if(data[CellIndex(nOff + i+1, j - 1)] >= 1)
         return true;
-    if(j+1 < m_Width && (nOff + i) > 0 && data[m_Width * (nOff + i) + j + 1] >= 1)
+    if(data[CellIndex(nOff + i, j + 1)] >= 1)
         return true;
-    if(j+1 < m_Width && (nOff + i+1) < m_Height && data[m_Width * (nOff + i+1) + j + 1] >= 1)
+    if(data[CellIndex(nOff + i+1, j + 1)] >= 1)
         return true;
-    if(i+1 < m_Height && data[m_Width * (i+1) + j] >= 1)
+    if(data[CellIndex(i+1, j)] >= 1)
         return true;
 
     return false;
 }
 
+void ReiterSimulation::UpdateReceptiveMask(float* data, unsigned char* mask, int rowStart, int rowEnd)
+{
+    for (int i = rowStart; i < rowEnd; i++)
+    {
+        for (int j = 0; j < m_Width; j++)
+        {
+            size_t cellId = CellIndex(i, j);
+            mask[cellId] = (CheckReceptiveCell(data, cellId) ? CELL_RECEPTIVE : 0) | (data[cellId] >= 1 ? CELL_FROZEN : 0);
+        }
+    }
+}
+
+void ReiterSimulation::InitReceptiveFrontier(float* data, unsigned char* mask, float alpha, float beta, float gamma)
+{
+    // Receptive cells only gain mass and diffusion cannot push a non-receptive
+    // cell over 1, so the frozen set only grows and the mask can be maintained
+    // from the cells next to it. Other parameters fall back to a full pass.
+    m_MonotoneGrowth = alpha >= 0 && alpha <= 2 && beta >= 0 && gamma >= 0;
+    m_Gamma = gamma;
+    m_Step = 0;
+
+    UpdateReceptiveMask(data, mask, 0, m_Height);
+
+    m_Frontier.clear();
+    m_Interior.clear();
+    if (!m_MonotoneGrowth)
+        return;
+
+    for (int i = 1; i < m_Height - 1; i++)
+    {
+        for (int j = 1; j < m_Width - 1; j++)
+        {
+            size_t cellId = CellIndex(i, j);
+            if ((mask[cellId] & CELL_RECEPTIVE) && !(mask[cellId] & CELL_FROZEN))
+                m_Frontier.push_back(cellId);
+            MarkInteriorCell(data, mask, cellId);
+        }
+    }
+    RemoveInteriorFromFrontier(mask);
+}
+
+void ReiterSimulation::AdvanceReceptiveFrontier(float* data, unsigned char* mask)
+{
+    m_Step++;
+
+    if (!m_MonotoneGrowth)
+    {
+        UpdateReceptiveMask(data, mask, 0, m_Height);
+        return;
+    }
+
+    size_t frozen = m_Frontier.size();
+    for (size_t k = 0; k < frozen; )
+    {
+        if (data[m_Frontier[k]] >= 1)
+            std::swap(m_Frontier[k], m_Frontier[--frozen]);
+        else
+            k++;
+    }
+
+    size_t idArray[6];
+    size_t idArrayS[6];
+    size_t last = m_Frontier.size();
+    for (size_t k = frozen; k < last; k++)
+    {
+        size_t cellId = m_Frontier[k];
+        mask[cellId] |= CELL_FROZEN;
+
+        GetNeighbourCellIds(cellId, idArray);
+        for (int n = 0; n < 6; n++)
+        {
+            size_t id = idArray[n];
+            if (mask[id] & CELL_RECEPTIVE)
+                continue;
+
+            mask[id] |= CELL_RECEPTIVE;
+
+            int i, j;
+            CellCoords(id, &i, &j);
+            if (i == 0 || j == 0 || m_Height - i == 1 || m_Width - j == 1)
+                continue;
+
+            m_Frontier.push_back(id);
+            MarkInteriorCell(data, mask, id);
+
+            GetNeighbourCellIds(id, idArrayS);
+            for (int v = 0; v < 6; v++)
+                MarkInteriorCell(data, mask, idArrayS[v]);
+        }
+    }
+
+    m_Frontier.erase(m_Frontier.begin() + frozen, m_Frontier.begin() + last);
+    RemoveInteriorFromFrontier(mask);
+}
+
+void ReiterSimulation::MaterializeInterior(float* data, size_t step)
+{
+    for (auto& cell : m_Interior)
+        data[cell.cellId] = cell.value + m_Gamma * (step - cell.step);
+}
+
+void ReiterSimulation::MarkInteriorCell(float* data, unsigned char* mask, size_t cellId)
+{
+    // A receptive cell surrounded by receptive cells has no diffusion term and only
+    // accumulates gamma, so its value is tracked in closed form from here on.
+    // Cells next to the border stay explicit since IsStable reads them.
+    if ((mask[cellId] & CELL_INTERIOR) || !(mask[cellId] & CELL_RECEPTIVE))
+        return;
+
+    int i, j;
+    CellCoords(cellId, &i, &j);
+    if (i <= 1 || j <= 1 || m_Height - i <= 2 || m_Width - j <= 2)
+        return;
+
+    size_t idArray[6];
+    GetNeighbourCellIds(cellId, idArray);
+    for (int n = 0; n < 6; n++)
+        if (!(mask[idArray[n]] & CELL_RECEPTIVE))
+            return;
+
+    mask[cellId] |= CELL_INTERIOR;
+    RecordInteriorCell(data, cellId);
+}
+
+void ReiterSimulation::RecordInteriorCell(float* data, size_t cellId)
+{
+    m_Interior.push_back({cellId, m_Step, data[cellId]});
+}
+
+void ReiterSimulation::RemoveInteriorFromFrontier(unsigned char* mask)
+{
+    size_t k = 0;
+    for (size_t cellId : m_Frontier)
+        if (!(mask[cellId] & CELL_INTERIOR))
+            m_Frontier[k++] = cellId;
+    m_Frontier.resize(k);
+}
+
+void ReiterSimulation::InitActiveBox(float* data, unsigned char* mask, float beta)
+{
+    m_Beta = beta;
+    m_ActiveBox = {m_Height, -1, m_Width, -1};
+
+    for (int i = 0; i < m_Height; i++)
+    {
+        for (int j = 0; j < m_Width; j++)
+        {
+            if (!IsActiveCell(data, mask, CellIndex(i, j)))
+                continue;
+
+            m_ActiveBox.rowMin = std::min(m_ActiveBox.rowMin, i);
+            m_ActiveBox.rowMax = std::max(m_ActiveBox.rowMax, i);
+            m_ActiveBox.colMin = std::min(m_ActiveBox.colMin, j);
+            m_ActiveBox.colMax = std::max(m_ActiveBox.colMax, j);
+        }
+    }
+}
+
+void ReiterSimulation::GrowActiveBox(float* data, unsigned char* mask)
+{
+    // Cells further than one step from the active box see only beta and
+    // non-receptive neighbours, so after an update anything new can only
+    // show up in the one-cell margin around it.
+    ActiveBox box = m_ActiveBox;
+    if (box.rowMin > box.rowMax)
+        return;
+
+    int rowStart = std::max(box.rowMin - 1, 0);
+    int rowEnd = std::min(box.rowMax + 1, m_Height - 1);
+    int colStart = std::max(box.colMin - 1, 0);
+    int colEnd = std::min(box.colMax + 1, m_Width - 1);
+
+    for (int j = colStart; j <= colEnd; j++)
+    {
+        if (rowStart < box.rowMin && IsActiveCell(data, mask, CellIndex(rowStart, j)))
+            m_ActiveBox.rowMin = rowStart;
+        if (rowEnd > box.rowMax && IsActiveCell(data, mask, CellIndex(rowEnd, j)))
+            m_ActiveBox.rowMax = rowEnd;
+    }
+
+    for (int i = rowStart; i <= rowEnd; i++)
+    {
+        if (colStart < box.colMin && IsActiveCell(data, mask, CellIndex(i, colStart)))
+            m_ActiveBox.colMin = colStart;
+        if (colEnd > box.colMax && IsActiveCell(data, mask, CellIndex(i, colEnd)))
+            m_ActiveBox.colMax = colEnd;
+    }
+}
+
+void ReiterSimulation::ExpandActiveBox(float* data, unsigned char* mask, int steps)
+{
+    // Several steps were taken without tracking the box, so anything new lies
+    // within that many cells of it. Rescan the whole band instead of one ring.
+    ActiveBox box = m_ActiveBox;
+    if (box.rowMin > box.rowMax)
+        return;
+
+    int rowStart = std::max(box.rowMin - steps, 0);
+    int rowEnd = std::min(box.rowMax + steps, m_Height - 1);
+    int colStart = std::max(box.colMin - steps, 0);
+    int colEnd = std::min(box.colMax + steps, m_Width - 1);
+
+    for (int i = rowStart; i <= rowEnd; i++)
+    {
+        for (int j = colStart; j <= colEnd; j++)
+        {
+            if (i >= box.rowMin && i <= box.rowMax && j >= box.colMin && j <= box.colMax)
+                continue;
+            if (!IsActiveCell(data, mask, CellIndex(i, j)))
+                continue;
+
+            m_ActiveBox.rowMin = std::min(m_ActiveBox.rowMin, i);
+            m_ActiveBox.rowMax = std::max(m_ActiveBox.rowMax, i);
+            m_ActiveBox.colMin = std::min(m_ActiveBox.colMin, j);
+            m_ActiveBox.colMax = std::max(m_ActiveBox.colMax, j);
+        }
+    }
+}
+
+void ReiterSimulation::GetActiveWindow(int* rowStart, int* rowEnd, int* colStart, int* colEnd, int steps)
+{
+    *rowStart = std::max(m_ActiveBox.rowMin - steps, 1);
+    *rowEnd = std::min(m_ActiveBox.rowMax + steps + 1, m_Height - 1);
+    *colStart = std::max(m_ActiveBox.colMin - steps, 1);
+    *colEnd = std::min(m_ActiveBox.colMax + steps + 1, m_Width - 1);
+
+    *rowEnd = std::max(*rowEnd, *rowStart);
+    *colEnd = std::max(*colEnd, *colStart);
+}
+
+bool ReiterSimulation::IsActiveCell(float* data, unsigned char* mask, size_t cellId)
+{
+    if (data[cellId] != m_Beta)
+        return true;
+
+    if (mask)
+        return mask[cellId] & CELL_RECEPTIVE;
+
+    return CheckReceptiveCell(data, cellId);
+}
+
+#if defined(__AVX512F__)
+
+// GCC flags the _mm512_undefined_* placeholders inside its own intrinsics
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+static inline __mmask16 LoadNonReceptive16(const unsigned char* mask)
+{
+    __m512i flags = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*)mask));
+    return _mm512_testn_epi32_mask(flags, _mm512_set1_epi32(CELL_RECEPTIVE));
+}
+
+static inline __m256 UpdateLanes8(__m256 value, __m256 sum, __m256 cellU, __m256 cellR, double alpha, float gamma)
+{
+    __m512d a = _mm512_set1_pd(alpha / 2.0);
+    __m512d six = _mm512_set1_pd(6.0);
+    __m512d res = _mm512_cvtps_pd(value);
+    res = _mm512_add_pd(res, _mm512_mul_pd(a, _mm512_sub_pd(_mm512_div_pd(_mm512_cvtps_pd(sum), six), _mm512_cvtps_pd(cellU))));
+    res = _mm512_add_pd(res, _mm512_cvtps_pd(_mm256_mul_ps(_mm256_set1_ps(gamma), cellR)));
+    return _mm512_cvtpd_ps(res);
+}
+
+static inline __m256 High8(__m512 v)
+{
+    return _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(v), 1));
+}
+
+#elif defined(__AVX2__)
+
+static inline __m256 LoadNonReceptive8(const unsigned char* mask)
+{
+    __m256i flags = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)mask));
+    flags = _mm256_and_si256(flags, _mm256_set1_epi32(CELL_RECEPTIVE));
+    return _mm256_castsi256_ps(_mm256_cmpeq_epi32(flags, _mm256_setzero_si256()));
+}
+
+static inline __m128 UpdateLanes4(__m128 value, __m128 sum, __m128 cellU, __m128 cellR, double alpha, float gamma)
+{
+    __m256d a = _mm256_set1_pd(alpha / 2.0);
+    __m256d six = _mm256_set1_pd(6.0);
+    __m256d res = _mm256_cvtps_pd(value);
+    res = _mm256_add_pd(res, _mm256_mul_pd(a, _mm256_sub_pd(_mm256_div_pd(_mm256_cvtps_pd(sum), six), _mm256_cvtps_pd(cellU))));
+    res = _mm256_add_pd(res, _mm256_cvtps_pd(_mm_mul_ps(_mm_set1_ps(gamma), cellR)));
+    return _mm256_cvtpd_ps(res);
+}
+
+#endif
+
+void ReiterSimulation::UpdateRow(float* curData, float* prevData, unsigned char* mask, int row, int colStart, int colEnd, float alpha, float gamma)
+{
+    if (m_Layout == GridLayout::SplitParity)
+    {
+        int oddOffset = OddColumnOffset();
+        size_t rowId = CellIndex(row, 0);
+
+        UpdateSpan(curData, prevData, mask, rowId + (colStart + 1) / 2, rowId + (colEnd + 1) / 2, oddOffset - m_Pitch - 1, oddOffset - 1, alpha, gamma);
+        UpdateSpan(curData, prevData, mask, rowId + oddOffset + colStart / 2, rowId + oddOffset + colEnd / 2, -oddOffset, m_Pitch - oddOffset, alpha, gamma);
+        return;
+    }
+
+    size_t rowId = CellIndex(row, 0);
+    UpdateRowCells(curData + rowId, prevData + rowId, mask + rowId, m_Pitch, colStart, colEnd, alpha, gamma);
+}
+
+void ReiterSimulation::UpdateRowCells(float* out, float* mid, unsigned char* maskMid, int pitch, int colStart, int colEnd, float alpha, float gamma)
+{
+    // Hexagonal update of one row, vectorised across columns. Both neighbour
+    // rows are loaded for the left and right pairs and the column parity
+    // picks between them per lane, so the kernel has no per-cell branches.
+    // Pointers are to a column of even parity in an offset layout whose rows
+    // are pitch apart.
+    int j = colStart;
+
+#if defined(__AVX2__)
+    float* up = mid - pitch;
+    float* down = mid + pitch;
+    unsigned char* maskUp = maskMid - pitch;
+    unsigned char* maskDown = maskMid + pitch;
+#endif
+
+#if defined(__AVX512F__)
+    __mmask16 odd = (colStart % 2 == 0 ? 0xAAAA : 0x5555);
+
+    for (; j + 16 <= colEnd; j += 16)
+    {
+        uint64_t flags[2];
+        memcpy(flags, maskMid + j, sizeof(flags));
+        if ((flags[0] & flags[1] & 0x0404040404040404ULL) == 0x0404040404040404ULL)
+            continue;
+
+        __m512 sum = _mm512_setzero_ps();
+        __mmask16 nr;
+
+        nr = LoadNonReceptive16(maskUp + j);
+        sum = _mm512_mask_add_ps(sum, nr, sum, _mm512_loadu_ps(up + j));
+
+        nr = (LoadNonReceptive16(maskUp + j - 1) & ~odd) | (LoadNonReceptive16(maskMid + j - 1) & odd);
+        sum = _mm512_mask_add_ps(sum, nr, sum, _mm512_mask_blend_ps(odd, _mm512_loadu_ps(up + j - 1), _mm512_loadu_ps(mid + j - 1)));
+
+        nr = (LoadNonReceptive16(maskMid + j - 1) & ~odd) | (LoadNonReceptive16(maskDown + j - 1) & odd);
+        sum = _mm512_mask_add_ps(sum, nr, sum, _mm512_mask_blend_ps(odd, _mm512_loadu_ps(mid + j - 1), _mm512_loadu_ps(down + j - 1)));
+
+        nr = (LoadNonReceptive16(maskUp + j + 1) & ~odd) | (LoadNonReceptive16(maskMid + j + 1) & odd);
+        sum = _mm512_mask_add_ps(sum, nr, sum, _mm512_mask_blend_ps(odd, _mm512_loadu_ps(up + j + 1), _mm512_loadu_ps(mid + j + 1)));
+
+        nr = (LoadNonReceptive16(maskMid + j + 1) & ~odd) | (LoadNonReceptive16(maskDown + j + 1) & odd);
+        sum = _mm512_mask_add_ps(sum, nr, sum, _mm512_mask_blend_ps(odd, _mm512_loadu_ps(mid + j + 1), _mm512_loadu_ps(down + j + 1)));
+
+        nr = LoadNonReceptive16(maskDown + j);
+        sum = _mm512_mask_add_ps(sum, nr, sum, _mm512_loadu_ps(down + j));
+
+        __m512 value = _mm512_loadu_ps(mid + j);
+        nr = LoadNonReceptive16(maskMid + j);
+        __m512 cellU = _mm512_maskz_mov_ps(nr, value);
+        __m512 cellR = _mm512_maskz_mov_ps(~nr, _mm512_set1_ps(1.0f));
+
+        __m256 lo = UpdateLanes8(_mm512_castps512_ps256(value), _mm512_castps512_ps256(sum), _mm512_castps512_ps256(cellU), _mm512_castps512_ps256(cellR), alpha, gamma);
+        __m256 hi = UpdateLanes8(High8(value), High8(sum), High8(cellU), High8(cellR), alpha, gamma);
+        _mm512_storeu_ps(out + j, _mm512_castpd_ps(_mm512_insertf64x4(_mm512_castps_pd(_mm512_castps256_ps512(lo)), _mm256_castps_pd(hi), 1)));
+    }
+#elif defined(__AVX2__)
+    __m256 odd = _mm256_castsi256_ps(colStart % 2 == 0 ? _mm256_setr_epi32(0, -1, 0, -1, 0, -1, 0, -1) : _mm256_setr_epi32(-1, 0, -1, 0, -1, 0, -1, 0));
+
+    for (; j + 8 <= colEnd; j += 8)
+    {
+        uint64_t flags;
+        memcpy(&flags, maskMid + j, sizeof(flags));
+        if ((flags & 0x0404040404040404ULL) == 0x0404040404040404ULL)
+            continue;
+
+        __m256 sum = _mm256_setzero_ps();
+        __m256 nr;
+
+        nr = LoadNonReceptive8(maskUp + j);
+        sum = _mm256_add_ps(sum, _mm256_and_ps(nr, _mm256_loadu_ps(up + j)));
+
+        nr = _mm256_blendv_ps(LoadNonReceptive8(maskUp + j - 1), LoadNonReceptive8(maskMid + j - 1), odd);
+        sum = _mm256_add_ps(sum, _mm256_and_ps(nr, _mm256_blendv_ps(_mm256_loadu_ps(up + j - 1), _mm256_loadu_ps(mid + j - 1), odd)));
+
+        nr = _mm256_blendv_ps(LoadNonReceptive8(maskMid + j - 1), LoadNonReceptive8(maskDown + j - 1), odd);
+        sum = _mm256_add_ps(sum, _mm256_and_ps(nr, _mm256_blendv_ps(_mm256_loadu_ps(mid + j - 1), _mm256_loadu_ps(down + j - 1), odd)));
+
+        nr = _mm256_blendv_ps(LoadNonReceptive8(maskUp + j + 1), LoadNonReceptive8(maskMid + j + 1), odd);
+        sum = _mm256_add_ps(sum, _mm256_and_ps(nr, _mm256_blendv_ps(_mm256_loadu_ps(up + j + 1), _mm256_loadu_ps(mid + j + 1), odd)));
+
+        nr = _mm256_blendv_ps(LoadNonReceptive8(maskMid + j + 1), LoadNonReceptive8(maskDown + j + 1), odd);
+        sum = _mm256_add_ps(sum, _mm256_and_ps(nr, _mm256_blendv_ps(_mm256_loadu_ps(mid + j + 1), _mm256_loadu_ps(down + j + 1), odd)));
+
+        nr = LoadNonReceptive8(maskDown + j);
+        sum = _mm256_add_ps(sum, _mm256_and_ps(nr, _mm256_loadu_ps(down + j)));
+
+        __m256 value = _mm256_loadu_ps(mid + j);
+        nr = LoadNonReceptive8(maskMid + j);
+        __m256 cellU = _mm256_and_ps(nr, value);
+        __m256 cellR = _mm256_andnot_ps(nr, _mm256_set1_ps(1.0f));
+
+        __m128 lo = UpdateLanes4(_mm256_castps256_ps128(value), _mm256_castps256_ps128(sum), _mm256_castps256_ps128(cellU), _mm256_castps256_ps128(cellR), alpha, gamma);
+        __m128 hi = UpdateLanes4(_mm256_extractf128_ps(value, 1), _mm256_extractf128_ps(sum, 1), _mm256_extractf128_ps(cellU, 1), _mm256_extractf128_ps(cellR, 1), alpha, gamma);
+        _mm256_storeu_ps(out + j, _mm256_set_m128(hi, lo));
+    }
+#endif
+
+    long evenOffsets[6] = {-pitch, -pitch - 1, -1, -pitch + 1, 1, pitch};
+    long oddOffsets[6] = {-pitch, -1, pitch - 1, 1, pitch + 1, pitch};
+    for (; j < colEnd; j++)
+    {
+        if (maskMid[j] & CELL_INTERIOR)
+            continue;
+
+        long* offsets = (j % 2 == 0 ? evenOffsets : oddOffsets);
+        float sum = 0;
+        for (int k = 0; k < 6; k++)
+            if (!(maskMid[j + offsets[k]] & CELL_RECEPTIVE))
+                sum += mid[j + offsets[k]];
+
+        float cellR = ((maskMid[j] & CELL_RECEPTIVE) ? 1.0 : 0.0);
+        float cellU = (cellR == 0.0 ? mid[j] : 0.0);
+
+        out[j] = mid[j] + (alpha / 2.0) * ((sum / 6.0) - cellU) + (gamma * cellR);
+    }
+}
+
+void ReiterSimulation::UpdateMaskRow(float* mid, unsigned char* maskMid, int pitch, int colStart, int colEnd)
+{
+    // Same rule as CheckReceptiveCell on a row of the offset layout, ghost
+    // cells included. Only the receptive flag is produced.
+    for (int j = colStart; j < colEnd; j++)
+    {
+        float* side = (j % 2 == 0 ? mid - pitch : mid);
+        bool receptive = mid[j] >= 1 || mid[j - pitch] >= 1 || mid[j + pitch] >= 1 ||
+            side[j - 1] >= 1 || side[j - 1 + pitch] >= 1 || side[j + 1] >= 1 || side[j + 1 + pitch] >= 1;
+        maskMid[j] = (receptive ? CELL_RECEPTIVE : 0);
+    }
+}
+
+void ReiterSimulation::UpdateSpan(float* curData, float* prevData, unsigned char* mask, size_t first, size_t last, int offA, int offB, float alpha, float gamma)
+{
+    // Cells of one parity in one row of the split layout. The neighbours sit
+    // at -pitch, offA, offB, offA + 1, offB + 1 and +pitch in the order used by
+    // GetNeighbourCellIds, so every lane does the same loads.
+    size_t s = first;
+
+#if defined(__AVX512F__)
+    for (; s + 16 <= last; s += 16)
+    {
+        uint64_t flags[2];
+        memcpy(flags, mask + s, sizeof(flags));
+        if ((flags[0] & flags[1] & 0x0404040404040404ULL) == 0x0404040404040404ULL)
+            continue;
+
+        __m512 sum = _mm512_setzero_ps();
+        __mmask16 nr;
+
+        nr = LoadNonReceptive16(mask + s - m_Pitch);
+        sum = _mm512_mask_add_ps(sum, nr, sum, _mm512_loadu_ps(prevData + s - m_Pitch));
+        nr = LoadNonReceptive16(mask + s + offA);
+        sum = _mm512_mask_add_ps(sum, nr, sum, _mm512_loadu_ps(prevData + s + offA));
+        nr = LoadNonReceptive16(mask + s + offB);
+        sum = _mm512_mask_add_ps(sum, nr, sum, _mm512_loadu_ps(prevData + s + offB));
+        nr = LoadNonReceptive16(mask + s + offA + 1);
+        sum = _mm512_mask_add_ps(sum, nr, sum, _mm512_loadu_ps(prevData + s + offA + 1));
+        nr = LoadNonReceptive16(mask + s + offB + 1);
+        sum = _mm512_mask_add_ps(sum, nr, sum, _mm512_loadu_ps(prevData + s + offB + 1));
+        nr = LoadNonReceptive16(mask + s + m_Pitch);
+        sum = _mm512_mask_add_ps(sum, nr, sum, _mm512_loadu_ps(prevData + s + m_Pitch));
+
+        __m512 value = _mm512_loadu_ps(prevData + s);
+        nr = LoadNonReceptive16(mask + s);
+        __m512 cellU = _mm512_maskz_mov_ps(nr, value);
+        __m512 cellR = _mm512_maskz_mov_ps(~nr, _mm512_set1_ps(1.0f));
+
+        __m256 lo = UpdateLanes8(_mm512_castps512_ps256(value), _mm512_castps512_ps256(sum), _mm512_castps512_ps256(cellU), _mm512_castps512_ps256(cellR), alpha, gamma);
+        __m256 hi = UpdateLanes8(High8(value), High8(sum), High8(cellU), High8(cellR), alpha, gamma);
+        _mm512_storeu_ps(curData + s, _mm512_castpd_ps(_mm512_insertf64x4(_mm512_castps_pd(_mm512_castps256_ps512(lo)), _mm256_castps_pd(hi), 1)));
+    }
+#elif defined(__AVX2__)
+    for (; s + 8 <= last; s += 8)
+    {
+        uint64_t flags;
+        memcpy(&flags, mask + s, sizeof(flags));
+        if ((flags & 0x0404040404040404ULL) == 0x0404040404040404ULL)
+            continue;
+
+        __m256 sum = _mm256_setzero_ps();
+        sum = _mm256_add_ps(sum, _mm256_and_ps(LoadNonReceptive8(mask + s - m_Pitch), _mm256_loadu_ps(prevData + s - m_Pitch)));
+        sum = _mm256_add_ps(sum, _mm256_and_ps(LoadNonReceptive8(mask + s + offA), _mm256_loadu_ps(prevData + s + offA)));
+        sum = _mm256_add_ps(sum, _mm256_and_ps(LoadNonReceptive8(mask + s + offB), _mm256_loadu_ps(prevData + s + offB)));
+        sum = _mm256_add_ps(sum, _mm256_and_ps(LoadNonReceptive8(mask + s + offA + 1), _mm256_loadu_ps(prevData + s + offA + 1)));
+        sum = _mm256_add_ps(sum, _mm256_and_ps(LoadNonReceptive8(mask + s + offB + 1), _mm256_loadu_ps(prevData + s + offB + 1)));
+        sum = _mm256_add_ps(sum, _mm256_and_ps(LoadNonReceptive8(mask + s + m_Pitch), _mm256_loadu_ps(prevData + s + m_Pitch)));
+
+        __m256 value = _mm256_loadu_ps(prevData + s);
+        __m256 nr = LoadNonReceptive8(mask + s);
+        __m256 cellU = _mm256_and_ps(nr, value);
+        __m256 cellR = _mm256_andnot_ps(nr, _mm256_set1_ps(1.0f));
+
+        __m128 lo = UpdateLanes4(_mm256_castps256_ps128(value), _mm256_castps256_ps128(sum), _mm256_castps256_ps128(cellU), _mm256_castps256_ps128(cellR), alpha, gamma);
+        __m128 hi = UpdateLanes4(_mm256_extractf128_ps(value, 1), _mm256_extractf128_ps(sum, 1), _mm256_extractf128_ps(cellU, 1), _mm256_extractf128_ps(cellR, 1), alpha, gamma);
+        _mm256_storeu_ps(curData + s, _mm256_set_m128(hi, lo));
+    }
+#endif
+
+    long offsets[6] = {-m_Pitch, offA, offB, offA + 1, offB + 1, m_Pitch};
+    for (; s < last; s++)
+    {
+        if (mask[s] & CELL_INTERIOR)
+            continue;
+
+        float sum = 0;
+        for (int k = 0; k < 6; k++)
+            if (!(mask[s + offsets[k]] & CELL_RECEPTIVE))
+                sum += prevData[s + offsets[k]];
+
+        float cellR = ((mask[s] & CELL_RECEPTIVE) ? 1.0 : 0.0);
+        float cellU = (cellR == 0.0 ? prevData[s] : 0.0);
+
+        curData[s] = prevData[s] + (alpha / 2.0) * ((sum / 6.0) - cellU) + (gamma * cellR);
+    }
+}
+
+#if defined(__AVX512F__)
+#pragma GCC diagnostic pop
+#endif
+
 void ReiterSimulation::LogState(float* data, size_t iter)
 {
     if (m_DebugFreq == DebugFreq::None)
         return;
 
+    // Snapshots are written from a dense copy without ghost cells or padding
+    std::vector<float> denseData((size_t)m_Width * m_Height);
+    for (int i = 0; i < m_Height; i++)
+        for (int j = 0; j < m_Width; j++)
+            denseData[(size_t)i * m_Width + j] = data[CellIndex(i, j)];
+    data = denseData.data();
+
     switch (m_DebugMode)
     {
         case DebugType::None:
@@ -120,6 +834,9 @@ void ReiterSimulation::LogState(float* data, size_t iter)
             SaveStateToTxt(data, std::string(typeid(*this).name()) + std::to_string(iter) + std::string(".txt"));
             SaveStateToImg(data, std::string(typeid(*this).name()) + std::to_string(iter) + std::string(".png"));
             return;
+        case DebugType::Raw:
+            SaveStateToRaw(data, std::string(typeid(*this).name()) + std::to_string(iter) + std::string(".bin"));
+            return;
     }
 }
 
@@ -131,7 +848,7 @@ void ReiterSimulation::SaveStateToTxt(float* data, const std::string& filename)
     {
         for (int j = 0; j < m_Width; j++)
         {
-            file << std::to_string(data[i * m_Width + j]);
+            file << std::to_string(data[(size_t)i * m_Width + j]);
             file << "\t";
         }
         file << "\n";
@@ -140,16 +857,27 @@ void ReiterSimulation::SaveStateToTxt(float* data, const std::string& filename)
     file.close();
 }
 
+void ReiterSimulation::SaveStateToRaw(float* data, const std::string& filename)
+{
+    std::ofstream file(filename, std::ios::binary);
+
+    int header[2] = {m_Width, m_Height};
+    file.write((const char*)header, sizeof(header));
+    file.write((const char*)data, (size_t)m_Width * m_Height * sizeof(float));
+
+    file.close();
+}
+
 void ReiterSimulation::SaveStateToImg(float* data, const std::string& filename)
 {
     int imgHeight = PIX_PER_CELL * 2 * m_Height + PIX_PER_CELL;
     int imgWidth = PIX_PER_CELL * m_Width;
     int imgPitch = ((32 * imgWidth + 31) / 32) * 4;
 
-    unsigned char *imageData = (unsigned char *)calloc(imgHeight * imgWidth * 4, sizeof(unsigned char));
+    unsigned char *imageData = (unsigned char *)calloc((size_t)imgHeight * imgWidth * 4, sizeof(unsigned char));
 
     float maxVal = 0;
-    for(int i = 0; i < m_Width * m_Height; i++)
+    for(size_t i = 0; i < (size_t)m_Width * m_Height; i++)
         if(data[i] > maxVal)
             maxVal = data[i];
 
@@ -166,16 +894,17 @@ void ReiterSimulation::SaveStateToImg(float* data, const std::string& filename)
             int imgI = nOff + (i * PIX_PER_CELL * 2);
             int imgJ = (j * PIX_PER_CELL);
 
-            float val = data[i * m_Width + j];
+            float val = data[(size_t)i * m_Width + j];
             unsigned char imgVal = (val / maxVal) * 255;
 
             for(int x = 0; x < PIX_PER_CELL; x++){
                 for (int y = 0; y < 2 * PIX_PER_CELL; y++){
                     //zapisemo barvo RGBA (v resnici little endian BGRA)
-                    imageData[4 * (imgI+y)*imgWidth + 4 * (imgJ+x) + 0] = imgVal; //Blue
-                    imageData[4 * (imgI+y)*imgWidth + 4 * (imgJ+x) + 1] = imgVal; // Green
-                    imageData[4 * (imgI+y)*imgWidth + 4 * (imgJ+x) + 2] = imgVal; // Red
-                    imageData[4 * (imgI+y)*imgWidth + 4 * (imgJ+x) + 3] = 255;   // Alpha
+                    size_t pixel = 4 * ((size_t)(imgI+y)*imgWidth + (imgJ+x));
+                    imageData[pixel + 0] = imgVal; //Blue
+                    imageData[pixel + 1] = imgVal; // Green
+                    imageData[pixel + 2] = imgVal; // Red
+                    imageData[pixel + 3] = 255;   // Alpha
                 }
             }
         }
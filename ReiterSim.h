@@ -2,42 +2,121 @@
 
 #include <string>
 #include <memory>
+#include <vector>
 
 #define MAX_ITER 1000
 #define PIX_PER_CELL 2
+#define GRID_ALIGNMENT 64
+
+#define CELL_RECEPTIVE 0x01
+#define CELL_FROZEN 0x02
+#define CELL_INTERIOR 0x04
 
 class ReiterSimulation {
 
     public:
-        ReiterSimulation(int width, int height) : m_Width(width), m_Height(height) {};
+        ReiterSimulation(int width, int height) : m_Width(width), m_Height(height), m_Pitch(GridPitch(width)) {};
 
         virtual double RunSimulation(float alpha, float beta, float gamma) = 0;
 
+        struct ParamSet {
+            int width, height;
+            float alpha, beta, gamma;
+        };
+
         static bool ParseInputParams(int argc, char** argv, int* width, int* height, float* alpha, float* beta, float* gamma);
+        static bool ReadParamSets(const char* filename, std::vector<ParamSet>* sets);
+        static int GetEnvOption(const char* name, int defaultValue);
 
     protected:
         
+        // Raw is the width and height as 32-bit integers followed by the
+        // rows of cells as floats
         enum class DebugType{
-            None, Txt, Img, All
+            None, Txt, Img, All, Raw
         };
 
         enum class DebugFreq{
             None, Last, EveryIter
         };
 
+        enum class GridLayout{
+            Offset, SplitParity
+        };
+
+        void SetGridSize(int width, int height);
         std::shared_ptr<float> CreateGrid(float beta);
+        float InitialCell(int i, int j, float beta);
+        std::shared_ptr<unsigned char> CreateMask();
+        size_t GridStorageSize();
+        size_t CellIndex(int i, int j);
+        void CellCoords(size_t cellId, int* i, int* j);
         void GetNeighbourCellIds(size_t cellId, size_t* outIdArray);
         bool CheckReceptiveCell(float* data, size_t cellId);
+        void UpdateReceptiveMask(float* data, unsigned char* mask, int rowStart, int rowEnd);
+        void InitReceptiveFrontier(float* data, unsigned char* mask, float alpha, float beta, float gamma);
+        void AdvanceReceptiveFrontier(float* data, unsigned char* mask);
+        void MaterializeInterior(float* data, size_t step);
+        void InitActiveBox(float* data, unsigned char* mask, float beta);
+        void GrowActiveBox(float* data, unsigned char* mask);
+        void ExpandActiveBox(float* data, unsigned char* mask, int steps);
+        void GetActiveWindow(int* rowStart, int* rowEnd, int* colStart, int* colEnd, int steps = 1);
+        void UpdateRow(float* curData, float* prevData, unsigned char* mask, int row, int colStart, int colEnd, float alpha, float gamma);
+        void UpdateRowCells(float* out, float* mid, unsigned char* maskMid, int pitch, int colStart, int colEnd, float alpha, float gamma);
+        void UpdateMaskRow(float* mid, unsigned char* maskMid, int pitch, int colStart, int colEnd);
         bool IsStable(float* data);
+        bool EdgeReached(float* rowData, int row);
+        bool EdgeReachedInBox(float* data, int rowStart, int rowEnd, int colStart, int colEnd);
 
         void LogState(float* data, size_t iter);
 
+        // Keeps the closed form of a cell that just turned interior, in
+        // m_Interior unless a backend stores it elsewhere
+        virtual void RecordInteriorCell(float* data, size_t cellId);
+
         int m_Width, m_Height;
+        int m_Pitch;
         DebugFreq m_DebugFreq = DebugFreq::Last;
+        DebugType m_DebugMode = DebugType::Img;
+        GridLayout m_Layout = GridLayout::Offset;
+
+        struct InteriorCell {
+            size_t cellId;
+            size_t step;
+            float value;
+        };
+
+        struct ActiveBox {
+            int rowMin, rowMax;
+            int colMin, colMax;
+        };
+
+        std::vector<size_t> m_Frontier;
+        std::vector<InteriorCell> m_Interior;
+        bool m_MonotoneGrowth = false;
+        float m_Gamma = 0;
+        size_t m_Step = 0;
+
+        ActiveBox m_ActiveBox;
+        float m_Beta = 0;
+
+        // Grid and mask storage kept between runs of the same model
+        struct PooledBuffer {
+            size_t size;
+            std::shared_ptr<void> data;
+        };
+
+        std::vector<PooledBuffer> m_BufferPool;
 
     private:
+        static int GridPitch(int width);
+        std::shared_ptr<void> AllocateBuffer(size_t size);
+        int OddColumnOffset();
         void SaveStateToTxt(float* data, const std::string& filename);
         void SaveStateToImg(float* data, const std::string& filename);
-
-        DebugType m_DebugMode = DebugType::Img;
+        void SaveStateToRaw(float* data, const std::string& filename);
+        void MarkInteriorCell(float* data, unsigned char* mask, size_t cellId);
+        void RemoveInteriorFromFrontier(unsigned char* mask);
+        bool IsActiveCell(float* data, unsigned char* mask, size_t cellId);
+        void UpdateSpan(float* curData, float* prevData, unsigned char* mask, size_t first, size_t last, int offA, int offB, float alpha, float gamma);
 };
\ No newline at end of file
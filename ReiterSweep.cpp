@@ -0,0 +1,59 @@
+#include "ReiterSweep.h"
+
+#include <algorithm>
+#include <omp.h>
+
+#define SWEEP_GROUPS 1
+
+double ReiterSweep::RunPoint(const ParamSet& point, bool log)
+{
+    // Concurrent points would write the same snapshot files, so the last
+    // state is only logged on request
+    SetGridSize(point.width, point.height);
+    m_DebugFreq = (log ? DebugFreq::Last : DebugFreq::None);
+
+    return RunSimulation(point.alpha, point.beta, point.gamma);
+}
+
+#ifndef REITER_NO_SWEEP_MAIN
+int main(int argc, char** argv){
+
+    std::vector<ReiterSimulation::ParamSet> points;
+
+    if (argc != 2 || !ReiterSimulation::ReadParamSets(argv[1], &points))
+    {
+        printf("Correct usage should be: %s <file with a line of <width> <height> <alpha> <beta> <gamma> per run>\n", argv[0]);
+        return -1;
+    }
+
+    // REITER_SWEEP_GROUPS points run at once, each on its share of the
+    // threads. 1 runs every point across all cores, the thread count runs
+    // one single-threaded point per core.
+    int threads = omp_get_max_threads();
+    int groups = std::min(std::max(ReiterSimulation::GetEnvOption("REITER_SWEEP_GROUPS", SWEEP_GROUPS), 1), threads);
+    bool log = ReiterSimulation::GetEnvOption("REITER_SWEEP_LOG", 0);
+
+    omp_set_max_active_levels(2);
+
+    #pragma omp parallel num_threads(groups)
+    {
+        ReiterSweep model(0, 0);
+        omp_set_num_threads(threads / groups);
+
+        #pragma omp for schedule(dynamic)
+        for (size_t k = 0; k < points.size(); k++)
+        {
+            auto& point = points[k];
+            auto dur = model.RunPoint(point, log);
+
+            #pragma omp critical
+            {
+                printf("{\"type\": \"Sweep\", \"groups\": %d, \"n\": %d, \"elapsed\": %lf, \"width\": %d, \"height\": %d, \"alpha\": %f, \"beta\": %f, \"gamma\": %f}\n", groups, threads / groups, dur, point.width, point.height, point.alpha, point.beta, point.gamma);
+                fflush(stdout);
+            }
+        }
+    }
+
+    return 0;
+}
+#endif
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "ReiterOpenMP.h"
+
+// Runs a list of parameter sets in one process. Each model is reused for
+// the points it is given, so its grids are allocated once per grid size.
+class ReiterSweep : public ReiterOpenMP{
+    public:
+        ReiterSweep(int width, int height) : ReiterOpenMP(width, height) {};
+
+        double RunPoint(const ParamSet& point, bool log);
+};
@@ -0,0 +1,262 @@
+#include "ReiterThreads.h"
+
+#include <chrono>
+#include <algorithm>
+
+#define TILE_ROWS 16
+#define TILE_COLS 256
+
+double ReiterThreads::RunSimulation(float alpha, float beta, float gamma)
+{
+    // REITER_THREADS threads including the calling one work on tiles of
+    // REITER_TILE_ROWS by REITER_TILE_COLS cells. Columns are kept to whole
+    // vectors of the row update.
+    int threads = ThreadCount();
+    m_TileRows = std::max(GetEnvOption("REITER_TILE_ROWS", TILE_ROWS), 1);
+    m_TileCols = (std::max(GetEnvOption("REITER_TILE_COLS", TILE_COLS), 1) + 15) / 16 * 16;
+    m_TileGridCols = (m_Width + m_TileCols - 1) / m_TileCols;
+    m_TileInterior.assign((size_t)((m_Height + m_TileRows - 1) / m_TileRows) * m_TileGridCols, 0);
+    m_InteriorCounted = 0;
+
+    auto curData = CreateGrid(beta);
+    auto prevData = CreateGrid(beta);
+    auto mask = CreateMask();
+
+    StartWorkers(threads);
+
+    size_t iter = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    InitReceptiveFrontier(prevData.get(), mask.get(), alpha, beta, gamma);
+    InitActiveBox(prevData.get(), mask.get(), beta);
+    CountInterior();
+
+    // The edge check is done on the tiles as they are updated, so the
+    // bookkeeping between steps is the only serial part
+    bool stable = IsStable(prevData.get());
+    while(!stable && iter <= MAX_ITER)
+    {
+        stable = RunStep(curData.get(), prevData.get(), mask.get(), alpha);
+
+        if(m_DebugFreq == DebugFreq::EveryIter){
+            MaterializeInterior(curData.get(), iter + 1);
+            LogState(curData.get(), iter);
+        }
+
+        curData.swap(prevData);
+        AdvanceReceptiveFrontier(prevData.get(), mask.get());
+        GrowActiveBox(prevData.get(), mask.get());
+        CountInterior();
+        iter++;
+    }
+    if(m_DebugFreq == DebugFreq::Last){
+        MaterializeInterior(prevData.get(), iter);
+        LogState(prevData.get(), iter);
+    }
+
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    StopWorkers();
+
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(stop - start);
+    return (duration.count() * 1e-6);
+}
+
+int ReiterThreads::ThreadCount()
+{
+    return std::max(GetEnvOption("REITER_THREADS", std::thread::hardware_concurrency()), 1);
+}
+
+void ReiterThreads::StartWorkers(int count)
+{
+    m_Queues.clear();
+    for (int w = 0; w < count; w++)
+        m_Queues.emplace_back(new TileQueue());
+
+    m_Stop = false;
+    m_Generation = 0;
+    for (int w = 1; w < count; w++)
+        m_Workers.emplace_back(&ReiterThreads::WorkerLoop, this, w);
+}
+
+void ReiterThreads::StopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> guard(m_WakeLock);
+        m_Stop = true;
+    }
+    m_Wake.notify_all();
+
+    for (auto& worker : m_Workers)
+        worker.join();
+    m_Workers.clear();
+}
+
+void ReiterThreads::WorkerLoop(int worker)
+{
+    size_t seen = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_WakeLock);
+            m_Wake.wait(lock, [&]{ return m_Stop || m_Generation != seen; });
+            if (m_Stop)
+                return;
+            seen = m_Generation;
+        }
+
+        DrainTiles(worker);
+    }
+}
+
+bool ReiterThreads::RunStep(float* curData, float* prevData, unsigned char* mask, float alpha)
+{
+    int rowStart, rowEnd, colStart, colEnd;
+    GetActiveWindow(&rowStart, &rowEnd, &colStart, &colEnd);
+
+    // Tiles of the fixed grid clipped to the window. Interior cells are
+    // skipped by the update and always lie inside the window, so what is
+    // left of the clipped area is the work, and a tile with none is dropped.
+    m_Tiles.clear();
+    for (int ti = rowStart / m_TileRows; ti * m_TileRows < rowEnd; ti++)
+    {
+        for (int tj = colStart / m_TileCols; tj * m_TileCols < colEnd; tj++)
+        {
+            Tile tile;
+            tile.rowStart = std::max(ti * m_TileRows, rowStart);
+            tile.rowEnd = std::min((ti + 1) * m_TileRows, rowEnd);
+            tile.colStart = std::max(tj * m_TileCols, colStart);
+            tile.colEnd = std::min((tj + 1) * m_TileCols, colEnd);
+
+            size_t area = (size_t)(tile.rowEnd - tile.rowStart) * (tile.colEnd - tile.colStart);
+            size_t interior = m_TileInterior[(size_t)ti * m_TileGridCols + tj];
+            tile.cost = (area > interior ? area - interior : 0);
+            if (tile.cost > 0)
+                m_Tiles.push_back(tile);
+        }
+    }
+
+    // Everything a worker reads is set before the first tile is queued, and
+    // the queue lock hands it over with the tile
+    m_CurData = curData;
+    m_PrevData = prevData;
+    m_Mask = mask;
+    m_Alpha = alpha;
+    m_EdgeReached.store(false, std::memory_order_relaxed);
+    m_Remaining.store(m_Tiles.size(), std::memory_order_relaxed);
+
+    DealTiles();
+
+    {
+        std::lock_guard<std::mutex> guard(m_WakeLock);
+        m_Generation++;
+    }
+    m_Wake.notify_all();
+
+    DrainTiles(0);
+    while (m_Remaining.load(std::memory_order_acquire) > 0)
+        std::this_thread::yield();
+
+    return m_EdgeReached.load(std::memory_order_relaxed);
+}
+
+void ReiterThreads::DealTiles()
+{
+    // Most expensive first, each to the least loaded queue, so every queue
+    // is sorted from its most to its least expensive tile
+    std::vector<int> order(m_Tiles.size());
+    for (size_t k = 0; k < order.size(); k++)
+        order[k] = k;
+    std::sort(order.begin(), order.end(), [&](int a, int b){
+        return m_Tiles[a].cost > m_Tiles[b].cost;
+    });
+
+    std::vector<size_t> load(m_Queues.size(), 0);
+    for (int tile : order)
+    {
+        int w = std::min_element(load.begin(), load.end()) - load.begin();
+        load[w] += m_Tiles[tile].cost;
+
+        std::lock_guard<std::mutex> guard(m_Queues[w]->lock);
+        m_Queues[w]->tiles.push_back(tile);
+        m_Queues[w]->size.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void ReiterThreads::DrainTiles(int worker)
+{
+    int tile;
+    while (PopTile(worker, &tile))
+    {
+        auto& t = m_Tiles[tile];
+        for (int i = t.rowStart; i < t.rowEnd; i++)
+            UpdateRow(m_CurData, m_PrevData, m_Mask, i, t.colStart, t.colEnd, m_Alpha, m_Gamma);
+
+        if (EdgeReachedInBox(m_CurData, t.rowStart, t.rowEnd, t.colStart, t.colEnd))
+            m_EdgeReached.store(true, std::memory_order_relaxed);
+        m_Remaining.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+bool ReiterThreads::PopTile(int worker, int* tile)
+{
+    // The owner takes from the front of its queue, thieves take from the
+    // back, starting with the next queue over
+    int count = m_Queues.size();
+    for (int k = 0; k < count; k++)
+    {
+        TileQueue& queue = *m_Queues[(worker + k) % count];
+        if (queue.size.load(std::memory_order_relaxed) == 0)
+            continue;
+
+        std::lock_guard<std::mutex> guard(queue.lock);
+        if (queue.tiles.empty())
+            continue;
+
+        if (k == 0)
+        {
+            *tile = queue.tiles.front();
+            queue.tiles.pop_front();
+        }
+        else
+        {
+            *tile = queue.tiles.back();
+            queue.tiles.pop_back();
+        }
+        queue.size.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    return false;
+}
+
+void ReiterThreads::CountInterior()
+{
+    // Interior cells are only ever added, so the per-tile counts follow the
+    // new entries of m_Interior
+    for (; m_InteriorCounted < m_Interior.size(); m_InteriorCounted++)
+    {
+        int i, j;
+        CellCoords(m_Interior[m_InteriorCounted].cellId, &i, &j);
+        m_TileInterior[(size_t)(i / m_TileRows) * m_TileGridCols + j / m_TileCols]++;
+    }
+}
+
+int main(int argc, char** argv){
+
+    int width, height;
+    float alpha, beta, gamma;
+
+    if (!ReiterSimulation::ParseInputParams(argc, argv, &width, &height, &alpha, &beta, &gamma))
+    {
+        printf("Correct usage should be: %s <width> <height> <alpha> <beta> <gamma>\n", argv[0]);
+        return -1;
+    }
+
+    ReiterThreads model(width, height);
+    auto dur = model.RunSimulation(alpha, beta, gamma);
+
+    printf("{\"type\": \"Threads\", \"n\": %d, \"elapsed\": %lf, \"width\": %d, \"height\": %d, \"alpha\": %f, \"beta\": %f, \"gamma\": %f},\n", ReiterThreads::ThreadCount(), dur, width, height, alpha, beta, gamma);
+
+    return 0;
+}
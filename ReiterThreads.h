@@ -0,0 +1,68 @@
+#pragma once
+
+#include "ReiterSim.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// Each step the active window is cut into tiles of a fixed grid, costed by
+// the cells in them that still need the update, and dealt to per-thread
+// queues. A thread works through its own queue from the most expensive tile
+// down and then steals the cheapest tiles left in the others.
+class ReiterThreads : public ReiterSimulation{
+    public:
+        ReiterThreads(int width, int height) : ReiterSimulation(width, height) {};
+
+        virtual double RunSimulation(float alpha, float beta, float gamma) override;
+
+        static int ThreadCount();
+
+    private:
+        struct Tile {
+            int rowStart, rowEnd;
+            int colStart, colEnd;
+            size_t cost;
+        };
+
+        struct TileQueue {
+            std::mutex lock;
+            std::deque<int> tiles;
+            std::atomic<int> size{0};
+        };
+
+        void StartWorkers(int count);
+        void StopWorkers();
+        void WorkerLoop(int worker);
+        bool RunStep(float* curData, float* prevData, unsigned char* mask, float alpha);
+        void DealTiles();
+        void DrainTiles(int worker);
+        bool PopTile(int worker, int* tile);
+        void CountInterior();
+
+        int m_TileRows = 1;
+        int m_TileCols = 1;
+        int m_TileGridCols = 1;
+        std::vector<size_t> m_TileInterior;
+        size_t m_InteriorCounted = 0;
+
+        std::vector<Tile> m_Tiles;
+        std::vector<std::unique_ptr<TileQueue>> m_Queues;
+        std::vector<std::thread> m_Workers;
+
+        // State of the step in flight, published to the workers by bumping
+        // m_Generation under m_WakeLock
+        std::mutex m_WakeLock;
+        std::condition_variable m_Wake;
+        size_t m_Generation = 0;
+        bool m_Stop = false;
+
+        float* m_CurData = nullptr;
+        float* m_PrevData = nullptr;
+        unsigned char* m_Mask = nullptr;
+        float m_Alpha = 0;
+        std::atomic<int> m_Remaining{0};
+        std::atomic<bool> m_EdgeReached{false};
+};
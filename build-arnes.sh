@@ -5,8 +5,23 @@ mkdir -p out
 echo "Building sequential..."
 g++ -o out/ReiterSequential -Wall ReiterSequential.cpp ReiterSim.cpp -Wl,-rpath,./lib -L./lib -l:"libfreeimage.so.3"
 
+echo "Building SIMD..."
+g++ -O3 -march=native -o out/ReiterSIMD -Wall ReiterSIMD.cpp ReiterSim.cpp -Wl,-rpath,./lib -L./lib -l:"libfreeimage.so.3"
+
+echo "Building ensemble..."
+g++ -O3 -march=native -o out/ReiterEnsemble -Wall ReiterEnsemble.cpp ReiterSim.cpp -Wl,-rpath,./lib -L./lib -l:"libfreeimage.so.3"
+
+echo "Building out-of-core..."
+g++ -O3 -march=native -o out/ReiterOutOfCore -Wall ReiterOutOfCore.cpp ReiterSim.cpp -Wl,-rpath,./lib -L./lib -l:"libfreeimage.so.3"
+
 echo "Building OpenMP..."
-g++ --openmp -o out/ReiterOpenMP -Wall ReiterOpenMP.cpp ReiterSim.cpp -Wl,-rpath,./lib -L./lib -l:"libfreeimage.so.3"
+g++ --openmp -O3 -march=native -o out/ReiterOpenMP -Wall ReiterOpenMP.cpp ReiterSim.cpp -Wl,-rpath,./lib -L./lib -l:"libfreeimage.so.3"
+
+echo "Building threads..."
+g++ -pthread -O3 -march=native -o out/ReiterThreads -Wall ReiterThreads.cpp ReiterSim.cpp -Wl,-rpath,./lib -L./lib -l:"libfreeimage.so.3"
+
+echo "Building sweep..."
+g++ --openmp -O3 -march=native -DREITER_NO_MAIN -o out/ReiterSweep -Wall ReiterSweep.cpp ReiterOpenMP.cpp ReiterSim.cpp -Wl,-rpath,./lib -L./lib -l:"libfreeimage.so.3"
 
 echo "Building CUDA..."
 module load CUDA
@@ -16,4 +31,10 @@ echo "Building MPI..."
 module load mpi/openmpi-4.1.3
 srun --reservation=fri-vr --partition=gpu mpic++ -o out/ReiterMPI -Wall ReiterMPI.cpp ReiterSim.cpp -Xlinker -rpath=./lib -L./lib -l:"libfreeimage.so.3"
 
+echo "Building Hybrid..."
+srun --reservation=fri-vr --partition=gpu mpic++ -fopenmp -O3 -march=native -DREITER_NO_MAIN -o out/ReiterHybrid -Wall ReiterHybrid.cpp ReiterMPI.cpp ReiterSim.cpp -Xlinker -rpath=./lib -L./lib -l:"libfreeimage.so.3"
+
+echo "Building MPI sweep..."
+srun --reservation=fri-vr --partition=gpu mpic++ -fopenmp -O3 -march=native -DREITER_NO_MAIN -DREITER_NO_SWEEP_MAIN -o out/ReiterMPISweep -Wall ReiterMPISweep.cpp ReiterSweep.cpp ReiterOpenMP.cpp ReiterSim.cpp -Xlinker -rpath=./lib -L./lib -l:"libfreeimage.so.3"
+
 echo "Build success!"
\ No newline at end of file
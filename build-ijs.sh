@@ -4,10 +4,24 @@ mkdir -p out
 
 g++ -o out/ReiterSequential -Wall ReiterSequential.cpp ReiterSim.cpp -Wl,-rpath,./lib -L./lib -l:"libfreeimage.so.3"
 
-g++ --openmp -o out/ReiterOpenMP -Wall ReiterOpenMP.cpp ReiterSim.cpp -Wl,-rpath,./lib -L./lib -l:"libfreeimage.so.3"
+g++ -O3 -march=native -o out/ReiterSIMD -Wall ReiterSIMD.cpp ReiterSim.cpp -Wl,-rpath,./lib -L./lib -l:"libfreeimage.so.3"
+
+g++ -O3 -march=native -o out/ReiterEnsemble -Wall ReiterEnsemble.cpp ReiterSim.cpp -Wl,-rpath,./lib -L./lib -l:"libfreeimage.so.3"
+
+g++ -O3 -march=native -o out/ReiterOutOfCore -Wall ReiterOutOfCore.cpp ReiterSim.cpp -Wl,-rpath,./lib -L./lib -l:"libfreeimage.so.3"
+
+g++ --openmp -O3 -march=native -o out/ReiterOpenMP -Wall ReiterOpenMP.cpp ReiterSim.cpp -Wl,-rpath,./lib -L./lib -l:"libfreeimage.so.3"
+
+g++ -pthread -O3 -march=native -o out/ReiterThreads -Wall ReiterThreads.cpp ReiterSim.cpp -Wl,-rpath,./lib -L./lib -l:"libfreeimage.so.3"
+
+g++ --openmp -O3 -march=native -DREITER_NO_MAIN -o out/ReiterSweep -Wall ReiterSweep.cpp ReiterOpenMP.cpp ReiterSim.cpp -Wl,-rpath,./lib -L./lib -l:"libfreeimage.so.3"
 
 module load CUDA/10.1.243-GCC-8.3.0
 nvcc ReiterCUDA.cu ReiterSim.cpp -O2 -o out/ReiterCUDA -Xlinker -rpath=./lib -L./lib -l:"libfreeimage.so.3"
 
 module load OpenMPI/4.1.0-GCC-10.2.0
-mpic++ -o out/ReiterMPI -Wall ReiterMPI.cpp ReiterSim.cpp -Xlinker -rpath=./lib -L./lib -l:"libfreeimage.so.3"
\ No newline at end of file
+mpic++ -o out/ReiterMPI -Wall ReiterMPI.cpp ReiterSim.cpp -Xlinker -rpath=./lib -L./lib -l:"libfreeimage.so.3"
+
+mpic++ -fopenmp -O3 -march=native -DREITER_NO_MAIN -o out/ReiterHybrid -Wall ReiterHybrid.cpp ReiterMPI.cpp ReiterSim.cpp -Xlinker -rpath=./lib -L./lib -l:"libfreeimage.so.3"
+
+mpic++ -fopenmp -O3 -march=native -DREITER_NO_MAIN -DREITER_NO_SWEEP_MAIN -o out/ReiterMPISweep -Wall ReiterMPISweep.cpp ReiterSweep.cpp ReiterOpenMP.cpp ReiterSim.cpp -Xlinker -rpath=./lib -L./lib -l:"libfreeimage.so.3"
\ No newline at end of file
@@ -14,6 +14,14 @@ echo "Executing sequential..."
 
 srun --reservation=fri-vr --partition=gpu out/ReiterSequential $2 $3 $4 $5 $6 >> $1
 
+echo "Executing SIMD..."
+
+srun --reservation=fri-vr --partition=gpu out/ReiterSIMD $2 $3 $4 $5 $6 >> $1
+
+echo "Executing out-of-core..."
+
+REITER_SCRATCH_DIR=${TMPDIR:-/tmp} srun --reservation=fri-vr --partition=gpu out/ReiterOutOfCore $2 $3 $4 $5 $6 >> $1
+
 echo "Executing OpenMP... (1 thread)"
 export OMP_NUM_THREADS=1
 srun --cpus-per-task=1 --reservation=fri-vr --partition=gpu out/ReiterOpenMP $2 $3 $4 $5 $6 >> $1
@@ -46,6 +54,18 @@ echo "Executing OpenMP... (128 thread)"
 export OMP_NUM_THREADS=128
 srun --cpus-per-task=128 --reservation=fri-vr --partition=gpu out/ReiterOpenMP $2 $3 $4 $5 $6 >> $1
 
+echo "Executing threads... (64 thread)"
+REITER_THREADS=64 srun --cpus-per-task=64 --reservation=fri-vr --partition=gpu out/ReiterThreads $2 $3 $4 $5 $6 >> $1
+
+echo "Executing threads... (128 thread)"
+REITER_THREADS=128 srun --cpus-per-task=128 --reservation=fri-vr --partition=gpu out/ReiterThreads $2 $3 $4 $5 $6 >> $1
+
+echo "Executing OpenMP dataflow... (64 thread)"
+REITER_DATAFLOW=1 OMP_NUM_THREADS=64 srun --cpus-per-task=64 --reservation=fri-vr --partition=gpu out/ReiterOpenMP $2 $3 $4 $5 $6 >> $1
+
+echo "Executing OpenMP dataflow... (128 thread)"
+REITER_DATAFLOW=1 OMP_NUM_THREADS=128 srun --cpus-per-task=128 --reservation=fri-vr --partition=gpu out/ReiterOpenMP $2 $3 $4 $5 $6 >> $1
+
 
 module load CUDA
 
@@ -77,4 +97,14 @@ echo "Executing MPI... (32 runner | 1 node)"
 srun --reservation=fri-vr --partition=all --mpi=pmix --ntasks=32 --nodes=1 out/ReiterMPI $2 $3 $4 $5 $6 >> $1
 
 echo "Executing MPI... (32 runner | 2 node)"
-srun --reservation=fri-vr --partition=all --mpi=pmix --ntasks=32 --nodes=2 out/ReiterMPI $2 $3 $4 $5 $6 >> $1
\ No newline at end of file
+srun --reservation=fri-vr --partition=all --mpi=pmix --ntasks=32 --nodes=2 out/ReiterMPI $2 $3 $4 $5 $6 >> $1
+
+echo "Executing MPI shared halos... (32 runner | 1 node)"
+REITER_SHARED_HALOS=1 srun --reservation=fri-vr --partition=all --mpi=pmix --ntasks=32 --nodes=1 out/ReiterMPI $2 $3 $4 $5 $6 >> $1
+
+echo "Executing Hybrid... (1 runner x 32 threads | 1 node)"
+export OMP_NUM_THREADS=32
+srun --reservation=fri-vr --partition=all --mpi=pmix --ntasks=1 --nodes=1 --cpus-per-task=32 out/ReiterHybrid $2 $3 $4 $5 $6 >> $1
+
+echo "Executing Hybrid... (2 runner x 32 threads | 2 node)"
+srun --reservation=fri-vr --partition=all --mpi=pmix --ntasks=2 --nodes=2 --cpus-per-task=32 out/ReiterHybrid $2 $3 $4 $5 $6 >> $1
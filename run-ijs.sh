@@ -14,6 +14,14 @@ echo "Executing sequential..."
 
 srun --reservation=fri out/ReiterSequential $2 $3 $4 $5 $6 >> $1
 
+echo "Executing SIMD..."
+
+srun --reservation=fri out/ReiterSIMD $2 $3 $4 $5 $6 >> $1
+
+echo "Executing out-of-core..."
+
+REITER_SCRATCH_DIR=${TMPDIR:-/tmp} srun --reservation=fri out/ReiterOutOfCore $2 $3 $4 $5 $6 >> $1
+
 echo "Executing OpenMP... (1 thread)"
 export OMP_NUM_THREADS=1
 srun --cpus-per-task=1 --reservation=fri out/ReiterOpenMP $2 $3 $4 $5 $6 >> $1
@@ -46,6 +54,18 @@ echo "Executing OpenMP... (128 thread)"
 export OMP_NUM_THREADS=128
 srun --cpus-per-task=128 --reservation=fri out/ReiterOpenMP $2 $3 $4 $5 $6 >> $1
 
+echo "Executing threads... (64 thread)"
+REITER_THREADS=64 srun --cpus-per-task=64 --reservation=fri out/ReiterThreads $2 $3 $4 $5 $6 >> $1
+
+echo "Executing threads... (128 thread)"
+REITER_THREADS=128 srun --cpus-per-task=128 --reservation=fri out/ReiterThreads $2 $3 $4 $5 $6 >> $1
+
+echo "Executing OpenMP dataflow... (64 thread)"
+REITER_DATAFLOW=1 OMP_NUM_THREADS=64 srun --cpus-per-task=64 --reservation=fri out/ReiterOpenMP $2 $3 $4 $5 $6 >> $1
+
+echo "Executing OpenMP dataflow... (128 thread)"
+REITER_DATAFLOW=1 OMP_NUM_THREADS=128 srun --cpus-per-task=128 --reservation=fri out/ReiterOpenMP $2 $3 $4 $5 $6 >> $1
+
 module load CUDA/10.1.243-GCC-8.3.0
 
 echo "Executing CUDA... (1 GPU)"
@@ -82,4 +102,14 @@ echo "Executing MPI... (64 runner | 1 node)"
 srun --reservation=fri  --mpi=pmix -n 64 -N 1 out/ReiterMPI $2 $3 $4 $5 $6 >> $1
 
 echo "Executing MPI... (64 runner | 2 node)"
-srun --reservation=fri  --mpi=pmix -n 64 -N 2 out/ReiterMPI $2 $3 $4 $5 $6 >> $1
\ No newline at end of file
+srun --reservation=fri  --mpi=pmix -n 64 -N 2 out/ReiterMPI $2 $3 $4 $5 $6 >> $1
+
+echo "Executing MPI shared halos... (64 runner | 1 node)"
+REITER_SHARED_HALOS=1 srun --reservation=fri  --mpi=pmix -n 64 -N 1 out/ReiterMPI $2 $3 $4 $5 $6 >> $1
+
+echo "Executing Hybrid... (1 runner x 64 threads | 1 node)"
+export OMP_NUM_THREADS=64
+srun --reservation=fri  --mpi=pmix -n 1 -N 1 --cpus-per-task=64 out/ReiterHybrid $2 $3 $4 $5 $6 >> $1
+
+echo "Executing Hybrid... (2 runner x 64 threads | 2 node)"
+srun --reservation=fri  --mpi=pmix -n 2 -N 2 --cpus-per-task=64 out/ReiterHybrid $2 $3 $4 $5 $6 >> $1
@@ -4,6 +4,8 @@ bash build.sh
 
 srun --reservation=fri out/ReiterSequential 100 100 1 0.5 0.01
 
+srun --reservation=fri out/ReiterSIMD 100 100 1 0.5 0.01
+
 export OMP_PLACES=cores
 export OMP_PROC_BIND=TRUE
 export OMP_NUM_THREADS=64